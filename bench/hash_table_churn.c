@@ -0,0 +1,83 @@
+/**
+ * @file hash_table_churn.c
+ * @brief Insert/delete churn benchmark for the hash table. A window of live
+ * keys slides over a much larger key space, the way sets and dictionaries are
+ * used by sliding window algorithms, and the probe lengths are reported as
+ * the table churns. Built with POSITRON_PROFILE by `make bench`.
+ **/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../src/gc.h"
+#include "../src/hash_table.h"
+#include "../src/interpreter.h"
+#include "../src/object.h"
+
+#define KEYS 200000
+#define WINDOW 1000
+#define ROUNDS 10
+
+static PString* keys[KEYS];
+
+/**
+ * @brief Prints the probe statistics gathered since the last report and
+ * resets them.
+ */
+static void report(const char* phase, HashTable* table) {
+  printf("  %-10s live %7d  tombstones %6d  capacity %8d  ", phase,
+         table->count, table->tombstones, table->capacity);
+  printf("probes/op %.2f  longest %d\n",
+         (double)hash_table_stats.probes / hash_table_stats.lookups,
+         hash_table_stats.longest_probe);
+  hash_table_stats = (HashTableStats){0};
+}
+
+int main() {
+  interpreter_init();
+  // the keys are only held by the C array, which the collector does not scan
+  gc_pause();
+  char buffer[32];
+  for (int i = 0; i < KEYS; i++) {
+    int length = snprintf(buffer, sizeof(buffer), "key%d", i);
+    keys[i] = p_object_string_new_n(buffer, length);
+  }
+
+  HashTable table;
+  hash_table_init(&table);
+  clock_t start = clock();
+
+  // slide a window of live keys across the key space, every step inserts
+  // the key entering the window, deletes the key leaving it and looks up a
+  // key still inside it
+  printf("sliding window of %d keys over %d keys\n", WINDOW, KEYS);
+  hash_table_stats = (HashTableStats){0};
+  for (int round = 0; round < ROUNDS; round++) {
+    for (int i = 0; i < KEYS; i++) {
+      hash_table_set(&table, keys[i], value_new_integer(i));
+      if (i >= WINDOW)
+        hash_table_delete(&table, keys[i - WINDOW]);
+      hash_table_get(&table, keys[i - (i >= WINDOW ? WINDOW / 2 : 0)]);
+    }
+    char phase[16];
+    snprintf(phase, sizeof(phase), "round %d", round + 1);
+    report(phase, &table);
+    for (int i = KEYS - WINDOW; i < KEYS; i++)
+      hash_table_delete(&table, keys[i]);
+  }
+
+  // fill the table with every key, then drain it down to a handful
+  printf("fill and drain\n");
+  for (int i = 0; i < KEYS; i++)
+    hash_table_set(&table, keys[i], value_new_integer(i));
+  report("filled", &table);
+  for (int i = 0; i < KEYS - 10; i++)
+    hash_table_delete(&table, keys[i]);
+  report("drained", &table);
+
+  printf("%.3fs\n", (double)(clock() - start) / CLOCKS_PER_SEC);
+  hash_table_free(&table);
+  gc_resume();
+  interpreter_free();
+  return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file hash_table_keys.c
+ * @brief Hash table micro-benchmark at 1k, 100k and 10M keys. Times inserts,
+ * successful and failed lookups, and deletes in nanoseconds per operation.
+ * `make bench` builds it twice, with the default Robin Hood table and with
+ * the linear probing table (POSITRON_HASH_LINEAR), to compare the two.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/gc.h"
+#include "../src/hash_table.h"
+#include "../src/interpreter.h"
+#include "../src/object.h"
+
+#define MAX_KEYS 10000000
+#define MAX_MISSES 1000000
+// operations per phase at the small sizes, repeated over the same keys
+#define MIN_OPERATIONS 10000000
+
+static PString** keys;
+static PString** misses;
+
+/**
+ * @brief Creates count interned strings named prefix0, prefix1, ...
+ */
+static PString** make_keys(const char* prefix, int count) {
+  PString** strings = malloc(sizeof(PString*) * count);
+  char buffer[32];
+  for (int i = 0; i < count; i++) {
+    int length = snprintf(buffer, sizeof(buffer), "%s%d", prefix, i);
+    strings[i] = p_object_string_new_n(buffer, length);
+  }
+  return strings;
+}
+
+static double seconds_since(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/**
+ * @brief Runs every phase with a table of count keys.
+ */
+static void run(int count) {
+  int rounds = count < MIN_OPERATIONS ? MIN_OPERATIONS / count : 1;
+  int miss_count = count < MAX_MISSES ? count : MAX_MISSES;
+  double operations = (double)count * rounds;
+  double insert = 0, hit = 0, miss = 0, delete = 0;
+  // keeps the lookups from being optimized away
+  size_t found = 0;
+
+  for (int round = 0; round < rounds; round++) {
+    HashTable table;
+    hash_table_init(&table);
+
+    clock_t start = clock();
+    for (int i = 0; i < count; i++)
+      hash_table_set(&table, keys[i], value_new_integer(i));
+    insert += seconds_since(start);
+
+    start = clock();
+    for (int i = 0; i < count; i++)
+      found += hash_table_get(&table, keys[i]) != NULL;
+    hit += seconds_since(start);
+
+    start = clock();
+    for (int i = 0; i < count; i++)
+      found += hash_table_get(&table, misses[i % miss_count]) != NULL;
+    miss += seconds_since(start);
+
+    start = clock();
+    for (int i = 0; i < count; i++)
+      hash_table_delete(&table, keys[i]);
+    delete += seconds_since(start);
+
+    hash_table_free(&table);
+  }
+
+  printf("  %8d keys: insert %6.1f  hit %6.1f  miss %6.1f  delete %6.1f"
+         " ns/op (%zu)\n",
+         count, insert * 1e9 / operations, hit * 1e9 / operations,
+         miss * 1e9 / operations, delete * 1e9 / operations,
+         found / rounds);
+}
+
+int main() {
+  interpreter_init();
+  // the keys are only held by the C array, which the collector does not scan
+  gc_pause();
+  keys = make_keys("key", MAX_KEYS);
+  misses = make_keys("miss", MAX_MISSES);
+
+  run(1000);
+  run(100000);
+  run(MAX_KEYS);
+
+  free(keys);
+  free(misses);
+  gc_resume();
+  interpreter_free();
+  return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file pool_churn.c
+ * @brief Allocation churn benchmark for the object pool. Keeps a window of
+ * live blocks in the sizes heap objects come in and replaces them at random,
+ * the way a loop creating temporary lists and structs does between
+ * collections, first with malloc and free and then with the pool.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/pool.h"
+
+#define LIVE 100000
+#define OPERATIONS 20000000
+
+static void* blocks[LIVE];
+static size_t sizes[LIVE];
+
+// sizes of a string, a list, a bound method and small struct instances
+static const size_t object_sizes[] = {32, 40, 40, 48, 56, 72};
+
+/**
+ * @brief Returns the next value of a small xorshift generator.
+ */
+static uint32_t next_random() {
+  static uint32_t state = 2463534242u;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+/**
+ * @brief Runs the churn pattern with the given allocator and returns the
+ * elapsed seconds.
+ */
+static double churn(void* (*allocate)(size_t), void (*release)(void*, size_t)) {
+  clock_t start = clock();
+  for (size_t i = 0; i < LIVE; i++) {
+    sizes[i] = object_sizes[next_random() % 6];
+    blocks[i] = allocate(sizes[i]);
+  }
+  for (size_t i = 0; i < OPERATIONS; i++) {
+    size_t slot = next_random() % LIVE;
+    release(blocks[slot], sizes[slot]);
+    sizes[slot] = object_sizes[next_random() % 6];
+    blocks[slot] = allocate(sizes[slot]);
+    // touch the block like an object initializer would
+    *(size_t*)blocks[slot] = i;
+  }
+  for (size_t i = 0; i < LIVE; i++)
+    release(blocks[i], sizes[i]);
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void* malloc_allocate(size_t size) {
+  return malloc(size);
+}
+
+static void malloc_release(void* block, size_t size) {
+  (void)size;
+  free(block);
+}
+
+int main() {
+  printf("%d live blocks, %d replacements\n", LIVE, OPERATIONS);
+  printf("  malloc: %.3fs\n", churn(malloc_allocate, malloc_release));
+  printf("  pool:   %.3fs\n", churn(pool_alloc, pool_release));
+  pool_print_stats();
+  pool_free();
+  return 0;
+}
@@ -9,7 +9,10 @@
 
 #include <stdio.h>
 
+#include <string.h>
+
 #include "block.h"
+#include "object.h"
 
 /**
  * @brief Allocates and returns a pointer to a new block.
@@ -18,21 +21,141 @@
  */
 Block* block_new() {
   Block* block = malloc(sizeof(Block));
-  block->opcodes = dyn_list_new(free);
-  block->constants = dyn_list_new((void*)(void*)value_free);
+  block->code = NULL;
+  block->lines = NULL;
+  block->size = 0;
+  block->capacity = 0;
+  block->constants = NULL;
+  block->constant_count = 0;
+  block->constant_capacity = 0;
+  block->constant_slots = NULL;
+  block->constant_slot_capacity = 0;
+  block->caches = NULL;
+  block->cache_count = 0;
+  block->cache_capacity = 0;
+  block->stack_depth = 0;
+  block->max_stack = 0;
   return block;
 }
 
+/**
+ * Net number of values each opcode leaves on the stack. Opcodes that only pop
+ * some of the time (OP_LOCAL_SET) or end the frame (OP_RETURN, OP_EXIT) count
+ * as popping nothing so the depth is never underestimated. OP_CALL and
+ * OP_INVOKE consume their arguments, taken from the operand, and OP_LIST
+ * consumes the elements counted by the emitter through block_adjust_stack().
+ */
+static const int8_t stack_effects[] = {
+    [OP_NOP] = 0,
+    [OP_POP] = -1,
+    [OP_DUPE] = 1,
+    [OP_SWAP] = 0,
+    [OP_EXIT] = 0,
+    [OP_RETURN] = 0,
+    [OP_PRINT] = -1,
+    [OP_LOCAL_SET] = 0,
+    [OP_LOCAL_GET] = 1,
+    [OP_NEGATE] = 0,
+    [OP_ADD] = -1,
+    [OP_SUB] = -1,
+    [OP_MUL] = -1,
+    [OP_DIV] = -1,
+    [OP_NOT] = 0,
+    [OP_LT] = -1,
+    [OP_GT] = -1,
+    [OP_LTE] = -1,
+    [OP_GTE] = -1,
+    [OP_EQ] = -1,
+    [OP_NEQ] = -1,
+    [OP_LIST] = 0,
+    [OP_INDEX] = -1,
+    [OP_CONSTANT] = 1,
+    [OP_CALL] = 0,
+    [OP_FIELD_GET] = 0,
+    [OP_FIELD_SET] = -2,
+    [OP_GLOBAL_GET_SLOT] = 1,
+    [OP_GLOBAL_SET_SLOT] = -1,
+    [OP_JUMP] = 0,
+    [OP_JUMP_BACK] = 0,
+    [OP_CJUMPF] = -1,
+    [OP_CJUMPT] = -1,
+    [OP_INVOKE] = 0,
+    [OP_CONSTANT_LONG] = 1,
+    [OP_LOCAL_GET_LONG] = 1,
+    [OP_LOCAL_SET_LONG] = 0,
+    [OP_GLOBAL_GET_SLOT_LONG] = 1,
+    [OP_GLOBAL_SET_SLOT_LONG] = -1,
+    [OP_FIELD_GET_LONG] = 0,
+    [OP_FIELD_SET_LONG] = -2,
+    [OP_INVOKE_LONG] = 0,
+    [OP_ADD_INT] = -1,
+    [OP_ADD_NUM] = -1,
+    [OP_SUB_INT] = -1,
+    [OP_SUB_NUM] = -1,
+    [OP_MUL_INT] = -1,
+    [OP_MUL_NUM] = -1,
+    [OP_LT_INT] = -1,
+    [OP_LT_NUM] = -1,
+    [OP_GT_INT] = -1,
+    [OP_GT_NUM] = -1,
+    [OP_LTE_INT] = -1,
+    [OP_LTE_NUM] = -1,
+    [OP_GTE_INT] = -1,
+    [OP_GTE_NUM] = -1,
+};
+
+/**
+ * @brief Applies a stack effect to the block's simulated stack depth and
+ * records the deepest point reached. The simulation runs over the code in
+ * emission order, which overestimates the depth across branches since every
+ * branch the parser emits leaves the stack at least as deep as it found it.
+ *
+ * @param block the block being emitted
+ * @param delta the number of values pushed (negative for pops)
+ */
+void block_adjust_stack(Block* block, int delta) {
+  block->stack_depth += delta;
+  if (block->stack_depth < 0)
+    block->stack_depth = 0;
+  if (block->stack_depth > block->max_stack)
+    block->max_stack = block->stack_depth;
+}
+
+/**
+ * @brief Appends a single byte to the block's code, growing the code and line
+ * arrays together when they run out of room.
+ *
+ * @param block the block to write to
+ * @param byte the byte to write
+ * @param line the source line the byte was emitted for
+ */
+static void block_write(Block* block, uint8_t byte, int line) {
+  if (block->size == block->capacity) {
+    block->capacity =
+        block->capacity < INITIAL_CAPACITY ? INITIAL_CAPACITY
+                                           : block->capacity * GROWTH_FACTOR;
+    block->code = realloc(block->code, sizeof(uint8_t) * block->capacity);
+    block->lines = realloc(block->lines, sizeof(int) * block->capacity);
+    if (!block->code || !block->lines) {
+      printf("Failed to allocate memory for block code.\n");
+      exit(1);
+    }
+  }
+  block->code[block->size] = byte;
+  block->lines[block->size] = line;
+  block->size++;
+}
+
 /**
  * @brief Adds a new opcode to a block.
  *
  * @param block the block to add the opcode to
  * @param opcode the opcode to add
+ * @param line the source line the opcode was emitted for
  */
-void block_new_opcode(Block* block, uint8_t opcode) {
-  uint8_t* bytes = malloc(sizeof(uint8_t));
-  *bytes = opcode;
-  dyn_list_add(block->opcodes, (void*)bytes);
+void block_new_opcode(Block* block, uint8_t opcode, int line) {
+  block_write(block, opcode, line);
+  block_adjust_stack(block, stack_effects[opcode]);
 }
 
 /**
@@ -41,15 +164,16 @@ void block_new_opcode(Block* block, uint8_t opcode) {
  * @param block the block to add the opcodes to
  * @param opcodeA the first opcode to add
  * @param opcodeB the second opcode to add
+ * @param line the source line the opcodes were emitted for
  */
-void block_new_opcodes(Block* block, uint8_t opcodeA, uint8_t opcodeB) {
-  uint8_t* bytes = malloc(sizeof(uint8_t));
-  *bytes = opcodeA;
-  dyn_list_add(block->opcodes, (void*)bytes);
-
-  bytes = malloc(sizeof(uint8_t));
-  *bytes = opcodeB;
-  dyn_list_add(block->opcodes, (void*)bytes);
+void block_new_opcodes(Block* block,
+                       uint8_t opcodeA,
+                       uint8_t opcodeB,
+                       int line) {
+  block_write(block, opcodeA, line);
+  block_write(block, opcodeB, line);
+  block_adjust_stack(block, opcodeA == OP_CALL ? -(int)opcodeB
+                                               : stack_effects[opcodeA]);
 }
 
 /**
@@ -59,34 +183,264 @@ void block_new_opcodes(Block* block, uint8_t opcodeA, uint8_t opcodeB) {
  * @param opcodeA the first opcode to add
  * @param opcodeB the second opcode to add
  * @param opcodeC the third opcode to add
+ * @param line the source line the opcodes were emitted for
  */
 void block_new_opcodes_3(Block* block,
                          uint8_t opcodeA,
                          uint8_t opcodeB,
-                         uint8_t opcodeC) {
-  uint8_t* bytes = malloc(sizeof(uint8_t));
-  *bytes = opcodeA;
-  dyn_list_add(block->opcodes, (void*)bytes);
+                         uint8_t opcodeC,
+                         int line) {
+  block_write(block, opcodeA, line);
+  block_write(block, opcodeB, line);
+  block_write(block, opcodeC, line);
+  block_adjust_stack(block, stack_effects[opcodeA]);
+}
+
+/**
+ * @brief Overwrites a big-endian two byte operand that was already emitted,
+ * used to back-patch jump distances once the target is known.
+ *
+ * @param block the block to patch
+ * @param offset the index of the high byte of the operand
+ * @param value the value to write
+ */
+void block_patch_u16(Block* block, size_t offset, uint16_t value) {
+  block->code[offset] = (value >> 8) & 0xFF;
+  block->code[offset + 1] = value & 0xFF;
+}
+
+/**
+ * @brief Checks whether two constants can share a slot in the constant pool.
+ * Numbers are compared bitwise so 0 and -0 stay distinct. Strings are
+ * interned, so like every other object they are equal only when identical.
+ *
+ * @param a the first constant
+ * @param b the second constant
+ * @return bool true if the constants are interchangeable
+ */
+static bool constant_equals(Value* a, Value* b) {
+  if (value_type(*a) != value_type(*b))
+    return false;
+  switch (value_type(*a)) {
+    case VAL_NULL:
+      return true;
+    case VAL_BOOL:
+      return value_as_boolean(*a) == value_as_boolean(*b);
+    case VAL_NUMBER: {
+      double x = value_as_number(*a);
+      double y = value_as_number(*b);
+      return memcmp(&x, &y, sizeof(double)) == 0;
+    }
+    case VAL_INTEGER:
+      return value_as_integer(*a) == value_as_integer(*b);
+    case VAL_OBJ:
+      return value_as_object(*a) == value_as_object(*b);
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Hashes a constant by the same bits constant_equals() compares.
+ *
+ * @param constant the constant to hash
+ * @return size_t the constant's hash
+ */
+static size_t constant_hash(Value* constant) {
+  uint64_t bits = 0;
+  switch (value_type(*constant)) {
+    case VAL_BOOL:
+      bits = value_as_boolean(*constant);
+      break;
+    case VAL_NUMBER: {
+      double number = value_as_number(*constant);
+      memcpy(&bits, &number, sizeof(double));
+      break;
+    }
+    case VAL_INTEGER:
+      bits = (uint64_t)value_as_integer(*constant);
+      break;
+    case VAL_OBJ:
+      bits = (uintptr_t)value_as_object(*constant);
+      break;
+    default:
+      break;
+  }
+  bits = (bits ^ (uint64_t)value_type(*constant)) * 0x9E3779B97F4A7C15ull;
+  return (size_t)(bits >> 32);
+}
+
+/**
+ * @brief Finds the slot of the constant index that holds constant, or the
+ * empty slot it would go in.
+ *
+ * @param block the block whose index to search
+ * @param constant the constant to look for
+ * @return uint32_t* the slot
+ */
+static uint32_t* find_constant_slot(Block* block, Value* constant) {
+  size_t mask = block->constant_slot_capacity - 1;
+  size_t i = constant_hash(constant) & mask;
+  while (block->constant_slots[i] != 0 &&
+         !constant_equals(&block->constants[block->constant_slots[i] - 1],
+                          constant))
+    i = (i + 1) & mask;
+  return &block->constant_slots[i];
+}
+
+/**
+ * @brief Doubles the constant index and reinserts every constant, keeping it
+ * at most half full.
+ *
+ * @param block the block whose index to grow
+ */
+static void grow_constant_slots(Block* block) {
+  free(block->constant_slots);
+  block->constant_slot_capacity = block->constant_slot_capacity < 16
+                                      ? 16
+                                      : block->constant_slot_capacity * 2;
+  block->constant_slots =
+      calloc(block->constant_slot_capacity, sizeof(uint32_t));
+  if (!block->constant_slots) {
+    printf("Failed to allocate memory for block constants.\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < block->constant_count; i++)
+    *find_constant_slot(block, &block->constants[i]) = i + 1;
+}
+
+/**
+ * @brief Adds a new constant to a block. Identical numbers, booleans, nulls
+ * and strings already in the pool are found through the block's constant
+ * index and reused instead of stored again.
+ *
+ * @param block the block to add the constant to
+ * @param constant the constant to add
+ * @return size_t the index of the constant in the pool
+ */
+size_t block_new_constant(Block* block, Value* constant) {
+  if ((block->constant_count + 1) * 2 > block->constant_slot_capacity)
+    grow_constant_slots(block);
+  uint32_t* slot = find_constant_slot(block, constant);
+  if (*slot != 0)
+    return *slot - 1;
+
+  if (block->constant_count == block->constant_capacity) {
+    block->constant_capacity = block->constant_capacity < INITIAL_CAPACITY
+                                   ? INITIAL_CAPACITY
+                                   : block->constant_capacity * GROWTH_FACTOR;
+    block->constants =
+        realloc(block->constants, sizeof(Value) * block->constant_capacity);
+    if (!block->constants) {
+      printf("Failed to allocate memory for block constants.\n");
+      exit(1);
+    }
+  }
+  block->constants[block->constant_count++] = *constant;
+  *slot = block->constant_count;
+  return block->constant_count - 1;
+}
+
+/**
+ * @brief Adds an empty inline cache to a block. Every field access
+ * instruction gets a cache of its own.
+ *
+ * @param block the block to add the cache to
+ * @param name the name of the field the instruction accesses
+ * @return size_t the index of the cache
+ */
+size_t block_new_cache(Block* block, PString* name) {
+  if (block->cache_count == block->cache_capacity) {
+    block->cache_capacity = block->cache_capacity < INITIAL_CAPACITY
+                                ? INITIAL_CAPACITY
+                                : block->cache_capacity * GROWTH_FACTOR;
+    block->caches =
+        realloc(block->caches, sizeof(InlineCache) * block->cache_capacity);
+    if (!block->caches) {
+      printf("Failed to allocate memory for block caches.\n");
+      exit(1);
+    }
+  }
+  block->caches[block->cache_count] =
+      (InlineCache){.name = name, .shape = NULL, .slot = 0};
+  return block->cache_count++;
+}
 
-  bytes = malloc(sizeof(uint8_t));
-  *bytes = opcodeB;
-  dyn_list_add(block->opcodes, (void*)bytes);
+/**
+ * @brief Adds an opcode that takes a single index operand. Operands that fit
+ * in a byte use the compact two byte form, larger ones use the long form with
+ * a big-endian 24-bit operand.
+ *
+ * @param block the block to add the opcode to
+ * @param opcode the one byte operand form of the opcode
+ * @param long_opcode the 24-bit operand form of the opcode
+ * @param operand the operand to encode
+ * @param line the source line the opcode was emitted for
+ */
+void block_new_opcode_operand(Block* block,
+                              uint8_t opcode,
+                              uint8_t long_opcode,
+                              size_t operand,
+                              int line) {
+  if (operand <= UINT8_MAX) {
+    block_new_opcodes(block, opcode, (uint8_t)operand, line);
+    return;
+  }
+  if (operand > MAX_LONG_OPERAND) {
+    printf("[line %d] Operand %zu exceeds the maximum of %d.\n", line, operand,
+           MAX_LONG_OPERAND);
+    exit(1);
+  }
+  block_write(block, long_opcode, line);
+  block_write(block, (operand >> 16) & 0xFF, line);
+  block_write(block, (operand >> 8) & 0xFF, line);
+  block_write(block, operand & 0xFF, line);
+  block_adjust_stack(block, stack_effects[long_opcode]);
+}
 
-  bytes = malloc(sizeof(uint8_t));
-  *bytes = opcodeC;
-  dyn_list_add(block->opcodes, (void*)bytes);
+/**
+ * @brief Adds a method call on the receiver sitting below the arguments. The
+ * cache index uses the compact three byte form when it fits in a byte and the
+ * five byte long form otherwise, followed by the argument count.
+ *
+ * @param block the block to add the opcode to
+ * @param cache the index of the call's inline cache
+ * @param argc the number of arguments
+ * @param line the source line the opcode was emitted for
+ */
+void block_new_invoke(Block* block, size_t cache, uint8_t argc, int line) {
+  if (cache <= UINT8_MAX) {
+    block_write(block, OP_INVOKE, line);
+    block_write(block, (uint8_t)cache, line);
+  } else {
+    if (cache > MAX_LONG_OPERAND) {
+      printf("[line %d] Operand %zu exceeds the maximum of %d.\n", line,
+             cache, MAX_LONG_OPERAND);
+      exit(1);
+    }
+    block_write(block, OP_INVOKE_LONG, line);
+    block_write(block, (cache >> 16) & 0xFF, line);
+    block_write(block, (cache >> 8) & 0xFF, line);
+    block_write(block, cache & 0xFF, line);
+  }
+  block_write(block, argc, line);
+  // the receiver and arguments are replaced by the result
+  block_adjust_stack(block, -(int)argc);
 }
 
 /**
- * @brief Adds a new constant to a block.
+ * @brief Adds a constant to the block along with the OP_CONSTANT or
+ * OP_CONSTANT_LONG opcode that loads it.
  *
  * @param block the block to add the constant to
  * @param constant the constant to add
+ * @param line the source line the constant was emitted for
+ * @return size_t the index of the constant in the pool
  */
-uint8_t block_new_constant(Block* block, Value* constant) {
-  Value* clone = value_clone(constant);
-  dyn_list_add(block->constants, (void*)clone);
-  return (uint8_t)block->constants->size - 1;
+size_t block_new_constant_opcode(Block* block, Value* constant, int line) {
+  size_t index = block_new_constant(block, constant);
+  block_new_opcode_operand(block, OP_CONSTANT, OP_CONSTANT_LONG, index, line);
+  return index;
 }
 
 /**
@@ -96,18 +450,22 @@ uint8_t block_new_constant(Block* block, Value* constant) {
  */
 void block_print(Block* block) {
   printf("========== Block ==========\n");
+  printf("max stack: %d\n", block->max_stack);
   printf("========== Opcodes ==========\n");
-  for (size_t i = 0; i < block->opcodes->size;) {
-    printf("%.8d: ", (int)i);
+  for (size_t i = 0; i < block->size;) {
+    printf("%.8d (line %d): ", (int)i, block->lines[i]);
     i += block_print_opcode(block, i);
     printf("\n");
   }
   printf("========== Constants ==========\n");
-  for (size_t i = 0; i < block->constants->size; i++) {
+  for (size_t i = 0; i < block->constant_count; i++) {
     printf("%.4d: ", (int)i);
-    value_print(block->constants->data[i]);
+    value_print(&block->constants[i]);
     printf("\n");
   }
+  printf("========== Caches ==========\n");
+  for (size_t i = 0; i < block->cache_count; i++)
+    printf("%.4d: %s\n", (int)i, block->caches[i].name->value);
   printf("========== End Block ==========\n");
 }
 
@@ -117,18 +475,29 @@ void block_print(Block* block) {
  * @param block
  */
 void block_free(Block* block) {
-  dyn_list_free(block->opcodes);
-  dyn_list_free(block->constants);
+  free(block->code);
+  free(block->lines);
+  free(block->constants);
+  free(block->constant_slots);
+  free(block->caches);
   free(block);
 }
 
+/**
+ * @brief Reads a big-endian 24-bit operand starting at offset.
+ */
+static int block_read_u24(Block* block, size_t offset) {
+  return block->code[offset] << 16 | block->code[offset + 1] << 8 |
+         block->code[offset + 2];
+}
+
 /**
  * @brief Prints an opcode name and returns the number of bytes the opcode
  * takes.
  */
 size_t block_print_opcode(Block* block, size_t index) {
-  uint8_t* opcode = (uint8_t*)block->opcodes->data[index];
-  switch (*opcode) {
+  uint8_t opcode = block->code[index];
+  switch (opcode) {
     case OP_NOP:
       printf("OP_NOP");
       return 1;
@@ -150,15 +519,6 @@ size_t block_print_opcode(Block* block, size_t index) {
     case OP_PRINT:
       printf("OP_PRINT");
       return 1;
-    case OP_GLOBAL_DEFINE:
-      printf("OP_GLOBAL_DEFINE");
-      return 1;
-    case OP_GLOBAL_SET:
-      printf("OP_GLOBAL_SET");
-      return 1;
-    case OP_GLOBAL_GET:
-      printf("OP_GLOBAL_GET");
-      return 1;
     case OP_NOT:
       printf("OP_NOT");
       return 1;
@@ -202,55 +562,126 @@ size_t block_print_opcode(Block* block, size_t index) {
       printf("OP_INDEX");
       return 1;
     case OP_CONSTANT:
-      printf("OP_CONSTANT [%d]", *(uint8_t*)block->opcodes->data[index + 1]);
+      printf("OP_CONSTANT [%d]", block->code[index + 1]);
       return 2;
     case OP_CALL:
-      printf("OP_CALL [%d]", *(uint8_t*)block->opcodes->data[index + 1]);
+      printf("OP_CALL [%d]", block->code[index + 1]);
       return 2;
     case OP_LOCAL_GET: {
-      uint8_t slot = *(uint8_t*)block->opcodes->data[index + 1];
+      uint8_t slot = block->code[index + 1];
       printf("OP_LOCAL_GET [%d]", slot);
       return 2;
     }
     case OP_LOCAL_SET: {
-      uint8_t slot = *(uint8_t*)block->opcodes->data[index + 1];
+      uint8_t slot = block->code[index + 1];
       printf("OP_LOCAL_SET [%d]", slot);
       return 2;
     }
-    case OP_FIELD_GET: {
-      printf("OP_FIELD_GET");
-      return 1;
-    }
-    case OP_FIELD_SET: {
-      printf("OP_FIELD_SET");
-      return 1;
-    }
+    case OP_GLOBAL_GET_SLOT:
+      printf("OP_GLOBAL_GET_SLOT [%d]", block->code[index + 1]);
+      return 2;
+    case OP_GLOBAL_SET_SLOT:
+      printf("OP_GLOBAL_SET_SLOT [%d]", block->code[index + 1]);
+      return 2;
+    case OP_FIELD_GET:
+      printf("OP_FIELD_GET [%d]", block->code[index + 1]);
+      return 2;
+    case OP_FIELD_SET:
+      printf("OP_FIELD_SET [%d]", block->code[index + 1]);
+      return 2;
     case OP_CJUMPF: {
-      uint16_t addr = *(uint8_t*)block->opcodes->data[index + 1] << 8 |
-                      *(uint8_t*)block->opcodes->data[index + 2];
+      uint16_t addr = block->code[index + 1] << 8 | block->code[index + 2];
       printf("OP_CJUMPF [%d]", addr);
       return 3;
     }
     case OP_CJUMPT: {
-      uint16_t addr = *(uint8_t*)block->opcodes->data[index + 1] << 8 |
-                      *(uint8_t*)block->opcodes->data[index + 2];
+      uint16_t addr = block->code[index + 1] << 8 | block->code[index + 2];
       printf("OP_CJUMPT [%d]", addr);
       return 3;
     }
     case OP_JUMP: {
-      uint16_t addr = *(uint8_t*)block->opcodes->data[index + 1] << 8 |
-                      *(uint8_t*)block->opcodes->data[index + 2];
+      uint16_t addr = block->code[index + 1] << 8 | block->code[index + 2];
       printf("OP_JUMP [%d]", addr);
       return 3;
     }
     case OP_JUMP_BACK: {
-      uint16_t addr = *(uint8_t*)block->opcodes->data[index + 1] << 8 |
-                      *(uint8_t*)block->opcodes->data[index + 2];
+      uint16_t addr = block->code[index + 1] << 8 | block->code[index + 2];
       printf("OP_JUMP_BACK [%d]", addr);
       return 3;
     }
+    case OP_INVOKE:
+      printf("OP_INVOKE [%d] [%d]", block->code[index + 1],
+             block->code[index + 2]);
+      return 3;
+    case OP_CONSTANT_LONG:
+      printf("OP_CONSTANT_LONG [%d]", block_read_u24(block, index + 1));
+      return 4;
+    case OP_LOCAL_GET_LONG:
+      printf("OP_LOCAL_GET_LONG [%d]", block_read_u24(block, index + 1));
+      return 4;
+    case OP_LOCAL_SET_LONG:
+      printf("OP_LOCAL_SET_LONG [%d]", block_read_u24(block, index + 1));
+      return 4;
+    case OP_GLOBAL_GET_SLOT_LONG:
+      printf("OP_GLOBAL_GET_SLOT_LONG [%d]", block_read_u24(block, index + 1));
+      return 4;
+    case OP_GLOBAL_SET_SLOT_LONG:
+      printf("OP_GLOBAL_SET_SLOT_LONG [%d]", block_read_u24(block, index + 1));
+      return 4;
+    case OP_FIELD_GET_LONG:
+      printf("OP_FIELD_GET_LONG [%d]", block_read_u24(block, index + 1));
+      return 4;
+    case OP_FIELD_SET_LONG:
+      printf("OP_FIELD_SET_LONG [%d]", block_read_u24(block, index + 1));
+      return 4;
+    case OP_INVOKE_LONG:
+      printf("OP_INVOKE_LONG [%d] [%d]", block_read_u24(block, index + 1),
+             block->code[index + 4]);
+      return 5;
+    case OP_ADD_INT:
+      printf("OP_ADD_INT");
+      return 1;
+    case OP_ADD_NUM:
+      printf("OP_ADD_NUM");
+      return 1;
+    case OP_SUB_INT:
+      printf("OP_SUB_INT");
+      return 1;
+    case OP_SUB_NUM:
+      printf("OP_SUB_NUM");
+      return 1;
+    case OP_MUL_INT:
+      printf("OP_MUL_INT");
+      return 1;
+    case OP_MUL_NUM:
+      printf("OP_MUL_NUM");
+      return 1;
+    case OP_LT_INT:
+      printf("OP_LT_INT");
+      return 1;
+    case OP_LT_NUM:
+      printf("OP_LT_NUM");
+      return 1;
+    case OP_GT_INT:
+      printf("OP_GT_INT");
+      return 1;
+    case OP_GT_NUM:
+      printf("OP_GT_NUM");
+      return 1;
+    case OP_LTE_INT:
+      printf("OP_LTE_INT");
+      return 1;
+    case OP_LTE_NUM:
+      printf("OP_LTE_NUM");
+      return 1;
+    case OP_GTE_INT:
+      printf("OP_GTE_INT");
+      return 1;
+    case OP_GTE_NUM:
+      printf("OP_GTE_NUM");
+      return 1;
     default:
-      printf("Unknown opcode: %d", *opcode);
+      printf("Unknown opcode: %d", opcode);
       return 1;
   }
 }
\ No newline at end of file
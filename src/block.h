@@ -14,6 +14,7 @@
 #include <stdlib.h>
 
 #include "dyn_list.h"
+#include "hash_table.h"
 #include "value.h"
 
 enum OpCode {
@@ -25,9 +26,6 @@ enum OpCode {
     OP_EXIT,
     OP_RETURN,
     OP_PRINT,
-    OP_GLOBAL_DEFINE,
-    OP_GLOBAL_SET,
-    OP_GLOBAL_GET,
     OP_LOCAL_SET,
     OP_LOCAL_GET,
 
@@ -53,29 +51,104 @@ enum OpCode {
     OP_CALL,
     OP_FIELD_GET,
     OP_FIELD_SET,
+    OP_GLOBAL_GET_SLOT,
+    OP_GLOBAL_SET_SLOT,
 
     // Three bytes
     OP_JUMP,
     OP_JUMP_BACK,
     OP_CJUMPF,
     OP_CJUMPT,
+    OP_INVOKE,
+
+    // Four bytes (24-bit operand)
+    OP_CONSTANT_LONG,
+    OP_LOCAL_GET_LONG,
+    OP_LOCAL_SET_LONG,
+    OP_GLOBAL_GET_SLOT_LONG,
+    OP_GLOBAL_SET_SLOT_LONG,
+    OP_FIELD_GET_LONG,
+    OP_FIELD_SET_LONG,
+
+    // Five bytes (24-bit operand and an argument count)
+    OP_INVOKE_LONG,
+
+    // Quickened forms of the arithmetic and comparison opcodes for integer
+    // and number operands, written over the generic opcode by the interpreter
+    // (1 byte)
+    OP_ADD_INT,
+    OP_ADD_NUM,
+    OP_SUB_INT,
+    OP_SUB_NUM,
+    OP_MUL_INT,
+    OP_MUL_NUM,
+    OP_LT_INT,
+    OP_LT_NUM,
+    OP_GT_INT,
+    OP_GT_NUM,
+    OP_LTE_INT,
+    OP_LTE_NUM,
+    OP_GTE_INT,
+    OP_GTE_NUM,
 };
 
+// largest operand that fits in the 24-bit long form of an opcode
+#define MAX_LONG_OPERAND 0xFFFFFF
+
+// per-instruction cache for a field access or method call, remembering where the field was
+// found on the last struct instance the instruction saw
+typedef struct InlineCache {
+    PString* name;
+    // template of the last receiver, NULL until the cache is first filled
+    PObject* shape;
+    uint32_t slot;
+} InlineCache;
+
 typedef struct Block {
-    dyn_list* opcodes;
-    dyn_list* constants;
+    uint8_t* code;
+    int* lines;
+    size_t size;
+    size_t capacity;
+    Value* constants;
+    size_t constant_count;
+    size_t constant_capacity;
+    // open addressed index of the constant pool for deduplication, each slot
+    // holds a constant's index plus one or 0 when empty
+    uint32_t* constant_slots;
+    size_t constant_slot_capacity;
+    InlineCache* caches;
+    size_t cache_count;
+    size_t cache_capacity;
+    int stack_depth;
+    int max_stack;
 } Block;
 
 // allocates and returns a pointer to a new block
 Block* block_new();
 // adds a new opcode to a block
-void block_new_opcode(Block* block, uint8_t opcode);
+void block_new_opcode(Block* block, uint8_t opcode, int line);
 // Adds two new opcodes to a block
-void block_new_opcodes(Block* block, uint8_t opcodeA, uint8_t opcodeB);
+void block_new_opcodes(Block* block, uint8_t opcodeA, uint8_t opcodeB, int line);
 // Adds three new opcodes to a block
-void block_new_opcodes_3(Block* block, uint8_t opcodeA, uint8_t opcodeB, uint8_t opcodeC);
-// adds a new constant to a block, returning the index of the constant
-uint8_t block_new_constant(Block* block, Value* constant);
+void block_new_opcodes_3(Block* block, uint8_t opcodeA, uint8_t opcodeB, uint8_t opcodeC, int line);
+// adds an opcode with one operand, using the long form if it does not fit in
+// a byte
+void block_new_opcode_operand(Block* block, uint8_t opcode, uint8_t long_opcode, size_t operand, int line);
+// adds a method call through the inline cache at index cache, using the long
+// form if the index does not fit in a byte
+void block_new_invoke(Block* block, size_t cache, uint8_t argc, int line);
+// adds a constant and the opcode to load it, returning the constant's index
+size_t block_new_constant_opcode(Block* block, Value* constant, int line);
+// applies a stack effect the opcodes themselves do not describe, such as
+// the values a variable length opcode consumes
+void block_adjust_stack(Block* block, int delta);
+// overwrites the two byte operand starting at offset with value
+void block_patch_u16(Block* block, size_t offset, uint16_t value);
+// adds a new constant to a block (or reuses an identical one), returning the
+// index of the constant
+size_t block_new_constant(Block* block, Value* constant);
+// adds an empty inline cache for a field access of name, returning its index
+size_t block_new_cache(Block* block, PString* name);
 // prints a block's information
 void block_print(Block* block);
 // frees the memory allocated by a block
@@ -0,0 +1,1293 @@
+/**
+ * @file gc.c
+ * @author Devin Arena
+ * @brief Tracing mark and sweep garbage collector for the interpreter heap.
+ * @since 10/16/2026
+ **/
+
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gc.h"
+#include "interpreter.h"
+#include "object.h"
+#include "parser.h"
+#include "pool.h"
+#include "positron.h"
+
+GC gc;
+
+// upper bounds of the pause histogram's buckets in milliseconds, the last
+// bucket holds everything longer
+static const double pause_buckets[GC_PAUSE_BUCKETS - 1] = {
+    0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50, 100};
+
+// a Chase-Lev work-stealing deque of gray objects. Its owner pushes and pops
+// at the bottom while other marking threads steal from the top
+typedef struct GCDeque {
+  _Alignas(64) _Atomic int64_t top;
+  _Alignas(64) _Atomic int64_t bottom;
+  _Atomic(PObject*) items[GC_DEQUE_SIZE];
+} GCDeque;
+
+// what one thread of a parallel collection works with, the main thread is
+// always the first
+typedef struct GCWorker {
+  GCDeque deque;
+  // blocks and slots the thread's share of the sweep freed
+  PoolBatch batch;
+  size_t* freed;
+  size_t freed_count;
+  size_t freed_capacity;
+  uint64_t objects_stolen;
+  uint64_t objects_freed;
+  uint64_t bytes_freed;
+  size_t live;
+  pthread_t thread;
+} GCWorker;
+
+static GCWorker workers[GC_MAX_THREADS];
+// the worker the current thread marks for, NULL outside of parallel marking
+static _Thread_local GCWorker* marking_worker;
+// threads other than the main thread wait on start for the next job and
+// signal done once every one of them has finished it
+static pthread_mutex_t workers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workers_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workers_done = PTHREAD_COND_INITIALIZER;
+static void (*workers_job)(GCWorker*);
+static uint64_t workers_generation;
+static size_t workers_running;
+static size_t workers_started;
+static bool workers_stopping;
+// objects that did not fit a full deque are pushed onto the gray stack under
+// this lock, overflow_count mirrors its size for threads looking for work
+static pthread_mutex_t overflow_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic size_t overflow_count;
+// marking threads that found no work, marking ends once all of them are idle
+static _Atomic size_t idle_workers;
+// the next slot of the object table a sweeping thread claims
+static _Atomic size_t sweep_next;
+
+/**
+ * @brief Initializes the collector's state.
+ */
+void gc_init() {
+  gc.nursery = malloc(GC_NURSERY_SIZE);
+  if (!gc.nursery) {
+    printf("Failed to allocate memory for the nursery.\n");
+    exit(1);
+  }
+  gc.nursery_top = gc.nursery;
+  gc.nursery_end = gc.nursery + GC_NURSERY_SIZE;
+  gc.remembered = NULL;
+  gc.remembered_count = 0;
+  gc.remembered_capacity = 0;
+  gc.copied = NULL;
+  gc.copied_count = 0;
+  gc.copied_capacity = 0;
+  gc.bytes_allocated = 0;
+  gc.next_gc = GC_MIN_HEAP;
+  gc.paused = 0;
+  gc.gray = NULL;
+  gc.gray_count = 0;
+  gc.gray_capacity = 0;
+  gc.incremental = false;
+  gc.max_pause = GC_MAX_PAUSE / 1e3;
+  gc.phase = GC_IDLE;
+  gc.slice_debt = 0;
+  gc.objects = NULL;
+  gc.object_count = 0;
+  gc.object_capacity = 0;
+  gc.free_slots = NULL;
+  gc.free_count = 0;
+  gc.free_capacity = 0;
+  gc.marks = NULL;
+  gc.sweep_cursor = 0;
+  gc.sweep_end = 0;
+  gc.sweep_start = 0;
+  gc.sweep_live = 0;
+  gc.pinned_count = 0;
+  gc.threads = GC_THREADS < GC_MAX_THREADS ? GC_THREADS : GC_MAX_THREADS;
+  gc.stats = (GCStats){0};
+}
+
+/**
+ * @brief Pushes an object onto one of the collector's growable stacks.
+ *
+ * @param stack the stack's array
+ * @param count the number of objects on the stack
+ * @param capacity the number of objects the array can hold
+ * @param object the object to push
+ */
+static void push_object(PObject*** stack,
+                        size_t* count,
+                        size_t* capacity,
+                        PObject* object) {
+  if (*count == *capacity) {
+    *capacity = *capacity < 64 ? 64 : *capacity * 2;
+    *stack = realloc(*stack, sizeof(PObject*) * *capacity);
+    if (!*stack) {
+      printf("Failed to allocate memory for the garbage collector.\n");
+      exit(1);
+    }
+  }
+  (*stack)[(*count)++] = object;
+}
+
+/**
+ * @brief Pushes an object onto the gray stack.
+ */
+static inline void push_gray(PObject* object) {
+  push_object(&gc.gray, &gc.gray_count, &gc.gray_capacity, object);
+}
+
+/**
+ * @brief Pushes a slot of the object table onto a growable stack.
+ *
+ * @param stack the stack's array
+ * @param count the number of slots on the stack
+ * @param capacity the number of slots the array can hold
+ * @param slot the slot to push
+ */
+static void push_slot(size_t** stack,
+                      size_t* count,
+                      size_t* capacity,
+                      size_t slot) {
+  if (*count == *capacity) {
+    *capacity = *capacity < 64 ? 64 : *capacity * 2;
+    *stack = realloc(*stack, sizeof(size_t) * *capacity);
+    if (!*stack) {
+      printf("Failed to allocate memory for the garbage collector.\n");
+      exit(1);
+    }
+  }
+  (*stack)[(*count)++] = slot;
+}
+
+/**
+ * @brief Sets an object's mark bit. Only one thread may be marking.
+ */
+static inline void set_mark(PObject* object) {
+  _Atomic uint64_t* word = &gc.marks[object->slot / 64];
+  atomic_store_explicit(
+      word,
+      atomic_load_explicit(word, memory_order_relaxed) |
+          (uint64_t)1 << (object->slot % 64),
+      memory_order_relaxed);
+}
+
+/**
+ * @brief Clears an object's mark bit. Only one thread may be marking.
+ */
+static inline void clear_mark(PObject* object) {
+  _Atomic uint64_t* word = &gc.marks[object->slot / 64];
+  atomic_store_explicit(
+      word,
+      atomic_load_explicit(word, memory_order_relaxed) &
+          ~((uint64_t)1 << (object->slot % 64)),
+      memory_order_relaxed);
+}
+
+/**
+ * @brief Gives a new old object a slot in the object table, reusing the slot
+ * of a freed object if there is one. While a sweep is running new objects
+ * always get a slot past the ones it frees from, so it never sees them.
+ *
+ * @param object the object to register
+ */
+void gc_register(PObject* object) {
+  size_t slot;
+  if (gc.free_count > 0 && gc.phase != GC_SWEEPING) {
+    slot = gc.free_slots[--gc.free_count];
+  } else {
+    if (gc.object_count == gc.object_capacity) {
+      size_t capacity = gc.object_capacity < 1024 ? 1024
+                                                  : gc.object_capacity * 2;
+      gc.objects = realloc(gc.objects, sizeof(PObject*) * capacity);
+      gc.marks = realloc((void*)gc.marks, sizeof(uint64_t) * (capacity / 64));
+      if (!gc.objects || !gc.marks) {
+        printf("Failed to allocate memory for the garbage collector.\n");
+        exit(1);
+      }
+      memset((void*)(gc.marks + gc.object_capacity / 64), 0,
+             sizeof(uint64_t) * ((capacity - gc.object_capacity) / 64));
+      gc.object_capacity = capacity;
+    }
+    slot = gc.object_count++;
+  }
+  gc.objects[slot] = object;
+  object->slot = slot;
+  clear_mark(object);
+}
+
+static void begin_marking();
+
+/**
+ * @brief Collects once the old generation would outgrow its threshold. In
+ * incremental mode this starts a collection instead, and only finishes it at
+ * once if allocation has outrun the slices so far that the heap doubled past
+ * the threshold.
+ *
+ * @param size the bytes about to be allocated
+ */
+static void collect_if_needed(size_t size) {
+  if (gc.bytes_allocated + size <= gc.next_gc || gc.paused > 0)
+    return;
+  if (!gc.incremental)
+    gc_collect();
+  else if (gc.phase == GC_IDLE)
+    begin_marking();
+  else if (gc.bytes_allocated + size > gc.next_gc * GC_HEAP_GROW_FACTOR)
+    gc_collect();
+}
+
+#ifdef POSITRON_GC_STRESS
+/**
+ * @brief Collects on every allocation. In incremental mode this instead
+ * empties the nursery and runs a slice of a collection that is always in
+ * progress, so objects are stored behind the write barriers as often as
+ * possible.
+ */
+static void gc_collect_stress() {
+  if (gc.paused > 0)
+    return;
+  if (!gc.incremental) {
+    gc_collect();
+    return;
+  }
+  gc_collect_minor();
+  if (gc.phase == GC_IDLE)
+    begin_marking();
+  gc_step(GC_SLICE_BYTES);
+}
+#endif
+
+/**
+ * @brief Records bytes allocated on behalf of an object after the object
+ * itself, such as the characters of a string or the elements of a list. They
+ * count towards the next collection but never trigger one, so the caller does
+ * not need to keep anything reachable.
+ *
+ * @param bytes the number of bytes allocated
+ */
+void gc_track(size_t bytes) {
+  gc.bytes_allocated += bytes;
+  if (gc.bytes_allocated > gc.stats.peak_bytes)
+    gc.stats.peak_bytes = gc.bytes_allocated;
+}
+
+/**
+ * @brief Records the allocation of an object, collecting first if the heap
+ * would grow past the threshold. Everything the caller still needs must be
+ * reachable from the roots when this is called.
+ *
+ * @param size the size of the object
+ */
+void gc_allocate(size_t size) {
+#ifdef POSITRON_GC_STRESS
+  gc_collect_stress();
+#else
+  collect_if_needed(size);
+#endif
+  gc.bytes_allocated += size;
+  if (gc.bytes_allocated > gc.stats.peak_bytes)
+    gc.stats.peak_bytes = gc.bytes_allocated;
+}
+
+/**
+ * @brief Allocates a young object by bumping the nursery's top. When the
+ * nursery is full a minor collection empties it first, followed by a
+ * collection of the old generation if promoting the survivors grew it past
+ * its threshold.
+ *
+ * @param size the size of the object
+ * @return PObject* the uninitialized object
+ */
+PObject* gc_allocate_young(size_t size) {
+  size = (size + GC_ALIGNMENT - 1) & ~(size_t)(GC_ALIGNMENT - 1);
+#ifdef POSITRON_GC_STRESS
+  gc_collect_stress();
+#endif
+  if (gc.nursery_top + size > gc.nursery_end) {
+    gc_collect_minor();
+    collect_if_needed(0);
+  }
+  PObject* object = (PObject*)gc.nursery_top;
+  gc.nursery_top += size;
+  return object;
+}
+
+/**
+ * @brief Adds an old object to the remembered set, whose references are
+ * treated as roots by the next minor collection.
+ *
+ * @param object the old object
+ */
+void gc_remember(PObject* object) {
+  object->remembered = true;
+  push_object(&gc.remembered, &gc.remembered_count, &gc.remembered_capacity,
+              object);
+}
+
+/**
+ * @brief Pushes an object onto a Chase-Lev deque. Only the deque's owner may
+ * push.
+ *
+ * @param deque the deque to push onto
+ * @param object the object to push
+ * @return bool false if the deque is full
+ */
+static bool deque_push(GCDeque* deque, PObject* object) {
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  if (bottom - top >= GC_DEQUE_SIZE)
+    return false;
+  atomic_store_explicit(&deque->items[bottom & (GC_DEQUE_SIZE - 1)], object,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  return true;
+}
+
+/**
+ * @brief Pops the most recently pushed object from a Chase-Lev deque. Only
+ * the deque's owner may pop.
+ *
+ * @param deque the deque to pop from
+ * @return PObject* the object, or NULL if the deque is empty
+ */
+static PObject* deque_pop(GCDeque* deque) {
+  int64_t bottom =
+      atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+  if (top > bottom) {
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return NULL;
+  }
+  PObject* object = atomic_load_explicit(
+      &deque->items[bottom & (GC_DEQUE_SIZE - 1)], memory_order_relaxed);
+  if (top == bottom) {
+    // the last object, a thief may be taking it at the same time
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+      object = NULL;
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  }
+  return object;
+}
+
+/**
+ * @brief Steals the least recently pushed object from another thread's
+ * Chase-Lev deque.
+ *
+ * @param deque the deque to steal from
+ * @return PObject* the object, or NULL if the deque was empty or another
+ * thread took the object first
+ */
+static PObject* deque_steal(GCDeque* deque) {
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+  if (top >= bottom)
+    return NULL;
+  PObject* object = atomic_load_explicit(
+      &deque->items[top & (GC_DEQUE_SIZE - 1)], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed))
+    return NULL;
+  return object;
+}
+
+/**
+ * @brief Returns whether a Chase-Lev deque looks empty to other threads.
+ */
+static inline bool deque_empty(GCDeque* deque) {
+  return atomic_load_explicit(&deque->top, memory_order_acquire) >=
+         atomic_load_explicit(&deque->bottom, memory_order_acquire);
+}
+
+/**
+ * @brief Marks an object from a marking thread and pushes it onto the
+ * thread's deque, or the shared gray stack when the deque is full. Setting
+ * the bit atomically makes sure only one thread traces each object.
+ *
+ * @param worker the marking thread's worker
+ * @param object the old object to mark
+ */
+static void mark_parallel(GCWorker* worker, PObject* object) {
+  uint64_t bit = (uint64_t)1 << (object->slot % 64);
+  if (atomic_fetch_or_explicit(&gc.marks[object->slot / 64], bit,
+                               memory_order_relaxed) &
+      bit)
+    return;
+  if (deque_push(&worker->deque, object))
+    return;
+  pthread_mutex_lock(&overflow_lock);
+  push_gray(object);
+  atomic_store_explicit(&overflow_count, gc.gray_count, memory_order_release);
+  pthread_mutex_unlock(&overflow_lock);
+}
+
+/**
+ * @brief Marks an object as reachable and queues it to have its references
+ * traced. Young objects are skipped, the ones that survive are marked when
+ * they are promoted.
+ *
+ * @param object the object to mark, may be NULL
+ */
+void gc_mark_object(PObject* object) {
+  if (object == NULL || gc_is_young(object))
+    return;
+  if (marking_worker != NULL) {
+    mark_parallel(marking_worker, object);
+    return;
+  }
+  if (gc_is_marked(object))
+    return;
+  set_mark(object);
+  push_gray(object);
+}
+
+/**
+ * @brief Marks the object held by a value, other values hold no references.
+ *
+ * @param value the value to mark
+ */
+void gc_mark_value(Value value) {
+  if (value_is_object(value))
+    gc_mark_object(value_as_object(value));
+}
+
+/**
+ * @brief Marks the keys and values of every entry in a table.
+ *
+ * @param table the table to mark
+ */
+void gc_mark_table(HashTable* table) {
+  for (int i = 0; i < table->capacity; i++) {
+    Entry* entry = &table->entries[i];
+    if (entry->key == NULL)
+      continue;
+    gc_mark_object((PObject*)entry->key);
+    gc_mark_value(entry->value);
+  }
+}
+
+/**
+ * @brief Keeps an object alive while only C code refers to it, such as a
+ * name the parser has created but not stored anywhere yet. Pins are released
+ * in the reverse order they were made.
+ *
+ * @param object the object to pin
+ */
+void gc_pin(PObject* object) {
+  if (gc.pinned_count == GC_MAX_PINNED) {
+    printf("Too many objects pinned by the garbage collector.\n");
+    exit(1);
+  }
+  gc.pinned[gc.pinned_count++] = object;
+}
+
+/**
+ * @brief Releases the most recently pinned objects.
+ *
+ * @param count the number of objects to release
+ */
+void gc_unpin(size_t count) {
+  gc.pinned_count -= count;
+}
+
+/**
+ * @brief Stops collecting the old generation, so C code can hold on to old
+ * objects the roots do not reach, such as strings kept in a C array. Minor
+ * collections still run since they never free old objects. Pauses nest and
+ * each must be matched by a gc_resume().
+ */
+void gc_pause() {
+  gc.paused++;
+}
+
+/**
+ * @brief Lets the old generation be collected again once every gc_pause()
+ * has been matched.
+ */
+void gc_resume() {
+  gc.paused--;
+}
+
+/**
+ * @brief Marks the roots that change without a write barrier, which an
+ * incremental collection marks again before it stops tracing.
+ */
+static void mark_stack_roots() {
+  for (int i = 0; i < interpreter.sp; i++)
+    gc_mark_value(interpreter.stack[i]);
+  for (int i = 0; i < interpreter.fp; i++)
+    gc_mark_object((PObject*)interpreter.frames[i].function);
+  for (size_t i = 0; i < gc.pinned_count; i++)
+    gc_mark_object(gc.pinned[i]);
+  parser_mark_roots();
+}
+
+/**
+ * @brief Marks everything the interpreter and parser can reach directly.
+ */
+static void mark_roots() {
+  mark_stack_roots();
+  for (size_t i = 0; i < interpreter.global_count; i++)
+    gc_mark_value(interpreter.globals[i]);
+  gc_mark_table(&interpreter.list_methods);
+}
+
+/**
+ * @brief Marks every object a reachable object refers to.
+ *
+ * @param object the object to trace
+ */
+static void blacken_object(PObject* object) {
+  switch (object->type) {
+    case P_OBJ_FUNCTION: {
+      PFunction* function = (PFunction*)object;
+      Block* block = function->block;
+      gc_mark_object((PObject*)function->name);
+      for (size_t i = 0; i < block->constant_count; i++)
+        gc_mark_value(block->constants[i]);
+      // cached templates are compared by address, so they must stay alive
+      // for as long as the cache can hit
+      for (size_t i = 0; i < block->cache_count; i++) {
+        gc_mark_object((PObject*)block->caches[i].name);
+        gc_mark_object(block->caches[i].shape);
+      }
+      break;
+    }
+    case P_OBJ_BUILTIN:
+      gc_mark_object((PObject*)((PBuiltin*)object)->name);
+      break;
+    case P_OBJ_STRUCT_TEMPLATE: {
+      PStructTemplate* template = (PStructTemplate*)object;
+      gc_mark_object((PObject*)template->name);
+      gc_mark_table(&template->fields);
+      break;
+    }
+    case P_OBJ_STRUCT_INSTANCE: {
+      PStructInstance* instance = (PStructInstance*)object;
+      gc_mark_object((PObject*)instance->template);
+      for (size_t i = 0; i < instance->field_count; i++)
+        gc_mark_value(instance->fields[i]);
+      break;
+    }
+    case P_OBJ_LIST: {
+      PList* list = (PList*)object;
+      for (size_t i = 0; i < list->count; i++)
+        gc_mark_value(list->values[i]);
+      break;
+    }
+    case P_OBJ_BOUND_METHOD: {
+      PBoundMethod* bound = (PBoundMethod*)object;
+      gc_mark_object(bound->receiver);
+      gc_mark_object((PObject*)bound->method);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Runs a thread of the parallel collector, which waits for a job,
+ * runs it with its worker and waits for the next one until the collector is
+ * freed.
+ *
+ * @param arg the thread's worker
+ */
+static void* worker_main(void* arg) {
+  GCWorker* worker = arg;
+  uint64_t generation = 0;
+  pthread_mutex_lock(&workers_lock);
+  for (;;) {
+    while (workers_generation == generation && !workers_stopping)
+      pthread_cond_wait(&workers_start, &workers_lock);
+    if (workers_stopping)
+      break;
+    generation = workers_generation;
+    void (*job)(GCWorker*) = workers_job;
+    pthread_mutex_unlock(&workers_lock);
+    job(worker);
+    pthread_mutex_lock(&workers_lock);
+    if (--workers_running == 0)
+      pthread_cond_signal(&workers_done);
+  }
+  pthread_mutex_unlock(&workers_lock);
+  return NULL;
+}
+
+/**
+ * @brief Runs a job on every thread of the parallel collector, with the main
+ * thread as the first worker, and waits for all of them to finish. The
+ * threads are started the first time they are needed.
+ *
+ * @param job the function each thread runs with its worker
+ */
+static void run_workers(void (*job)(GCWorker*)) {
+  while (workers_started < gc.threads - 1) {
+    GCWorker* worker = &workers[workers_started + 1];
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+      printf("Failed to start a garbage collector thread.\n");
+      exit(1);
+    }
+    workers_started++;
+  }
+  pthread_mutex_lock(&workers_lock);
+  workers_job = job;
+  workers_running = gc.threads - 1;
+  workers_generation++;
+  pthread_cond_broadcast(&workers_start);
+  pthread_mutex_unlock(&workers_lock);
+
+  job(&workers[0]);
+
+  pthread_mutex_lock(&workers_lock);
+  while (workers_running > 0)
+    pthread_cond_wait(&workers_done, &workers_lock);
+  pthread_mutex_unlock(&workers_lock);
+}
+
+/**
+ * @brief Returns whether the shared gray stack or any deque has objects left
+ * to trace.
+ */
+static bool mark_work_available() {
+  if (atomic_load_explicit(&overflow_count, memory_order_acquire) > 0)
+    return true;
+  for (size_t i = 0; i < gc.threads; i++) {
+    if (!deque_empty(&workers[i].deque))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Finds an object to trace once a marking thread's own deque is empty,
+ * first from the shared gray stack and then by stealing from the other
+ * threads in turn.
+ *
+ * @param worker the marking thread's worker
+ * @return PObject* the object, or NULL if none was found
+ */
+static PObject* find_mark_work(GCWorker* worker) {
+  if (atomic_load_explicit(&overflow_count, memory_order_acquire) > 0) {
+    PObject* object = NULL;
+    pthread_mutex_lock(&overflow_lock);
+    if (gc.gray_count > 0)
+      object = gc.gray[--gc.gray_count];
+    atomic_store_explicit(&overflow_count, gc.gray_count, memory_order_release);
+    pthread_mutex_unlock(&overflow_lock);
+    if (object != NULL)
+      return object;
+  }
+  size_t self = worker - workers;
+  for (size_t i = 1; i < gc.threads; i++) {
+    PObject* object = deque_steal(&workers[(self + i) % gc.threads].deque);
+    if (object != NULL) {
+      worker->objects_stolen++;
+      return object;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Traces objects from a thread's deque, then from the other threads,
+ * until every thread has run out of objects to trace. A thread that finds
+ * nothing counts itself idle and waits for more work to show up, which only
+ * happens while some thread is still tracing.
+ *
+ * @param worker the marking thread's worker
+ */
+static void mark_job(GCWorker* worker) {
+  marking_worker = worker;
+  for (;;) {
+    PObject* object;
+    while ((object = deque_pop(&worker->deque)) != NULL)
+      blacken_object(object);
+    if ((object = find_mark_work(worker)) != NULL) {
+      blacken_object(object);
+      continue;
+    }
+
+    atomic_fetch_add_explicit(&idle_workers, 1, memory_order_acq_rel);
+    for (;;) {
+      if (atomic_load_explicit(&idle_workers, memory_order_acquire) ==
+          gc.threads) {
+        marking_worker = NULL;
+        return;
+      }
+      if (mark_work_available()) {
+        atomic_fetch_sub_explicit(&idle_workers, 1, memory_order_acq_rel);
+        break;
+      }
+      sched_yield();
+    }
+  }
+}
+
+/**
+ * @brief Traces the gray objects on every collector thread, dealing them out
+ * to the threads' deques first.
+ */
+static void trace_parallel() {
+  for (size_t i = 0; gc.gray_count > 0; i++) {
+    if (!deque_push(&workers[i % gc.threads].deque,
+                    gc.gray[gc.gray_count - 1]))
+      break;
+    gc.gray_count--;
+  }
+  atomic_store_explicit(&overflow_count, gc.gray_count, memory_order_relaxed);
+  atomic_store_explicit(&idle_workers, 0, memory_order_relaxed);
+  run_workers(mark_job);
+
+  gc.stats.parallel_marks++;
+  for (size_t i = 0; i < gc.threads; i++) {
+    gc.stats.objects_stolen += workers[i].objects_stolen;
+    workers[i].objects_stolen = 0;
+  }
+}
+
+/**
+ * @brief Traces the references of marked objects until none are left. Large
+ * heaps are traced on every collector thread.
+ */
+static void trace_references() {
+  if (gc.threads > 1 && gc.object_count >= GC_PARALLEL_MIN_OBJECTS &&
+      gc.gray_count > 0) {
+    trace_parallel();
+    return;
+  }
+  while (gc.gray_count > 0)
+    blacken_object(gc.gray[--gc.gray_count]);
+}
+
+/**
+ * @brief Returns the current time in seconds from a monotonic clock.
+ */
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Counts a pause in its histogram bucket.
+ *
+ * @param pause the length of the pause in seconds
+ */
+static void record_pause(double pause) {
+  size_t bucket = 0;
+  while (bucket < GC_PAUSE_BUCKETS - 1 &&
+         pause * 1e3 >= pause_buckets[bucket])
+    bucket++;
+  gc.stats.pauses[bucket]++;
+}
+
+/**
+ * @brief Traces gray objects until none are left, the slice has traced
+ * budget bytes of objects or it has run past its deadline. The clock is only
+ * read every few objects.
+ *
+ * @param budget the bytes of objects to trace
+ * @param deadline the time to stop at
+ * @return bool whether the gray stack is empty
+ */
+static bool mark_slice(size_t budget, double deadline) {
+  size_t work = 0;
+  for (size_t traced = 1; gc.gray_count > 0 && work < budget; traced++) {
+    PObject* object = gc.gray[--gc.gray_count];
+    work += p_object_size(object);
+    blacken_object(object);
+    if (traced % 64 == 0 && now() > deadline)
+      break;
+  }
+  return gc.gray_count == 0;
+}
+
+/**
+ * @brief Ends the sweep, setting the threshold for the next collection from
+ * what survived.
+ */
+static void finish_sweep() {
+  // what survived plus what was allocated while sweeping, the latter can
+  // come out negative when dead young lists released their elements
+  gc.bytes_allocated = gc.bytes_allocated > gc.sweep_start
+                           ? gc.sweep_live + gc.bytes_allocated - gc.sweep_start
+                           : gc.sweep_live;
+  gc.next_gc = gc.bytes_allocated * GC_HEAP_GROW_FACTOR;
+  if (gc.next_gc < GC_MIN_HEAP)
+    gc.next_gc = GC_MIN_HEAP;
+  gc.phase = GC_IDLE;
+  gc.stats.collections++;
+}
+
+/**
+ * @brief Frees the unmarked objects in the slots the sweep has not reached
+ * yet, until it reaches the end of them, the slice has swept budget bytes of
+ * objects or it has run past its deadline. Reaching the end ends the
+ * collection.
+ *
+ * @param budget the bytes of objects to sweep
+ * @param deadline the time to stop at
+ */
+static void sweep_slice(size_t budget, double deadline) {
+  size_t work = 0;
+  for (size_t swept = 1; gc.sweep_cursor < gc.sweep_end && work < budget;
+       swept++) {
+    size_t slot = gc.sweep_cursor++;
+    PObject* object = gc.objects[slot];
+    if (object == NULL)
+      continue;
+    size_t size = p_object_size(object);
+    work += size;
+    if (gc_is_marked(object)) {
+      gc.sweep_live += size;
+    } else {
+      gc.objects[slot] = NULL;
+      push_slot(&gc.free_slots, &gc.free_count, &gc.free_capacity, slot);
+      p_object_free(object);
+      gc.stats.objects_freed++;
+      gc.stats.bytes_freed += size;
+    }
+    if (swept % 64 == 0 && now() > deadline)
+      break;
+  }
+  if (gc.sweep_cursor == gc.sweep_end)
+    finish_sweep();
+}
+
+/**
+ * @brief Sweeps chunks of the object table claimed from the shared cursor
+ * until none are left. Freed blocks and slots are kept by the worker, so the
+ * pool and the object table are only touched by the main thread.
+ *
+ * @param worker the sweeping thread's worker
+ */
+static void sweep_job(GCWorker* worker) {
+  for (;;) {
+    size_t start = atomic_fetch_add_explicit(&sweep_next, GC_SWEEP_CHUNK,
+                                             memory_order_relaxed);
+    if (start >= gc.sweep_end)
+      return;
+    size_t end = start + GC_SWEEP_CHUNK < gc.sweep_end
+                     ? start + GC_SWEEP_CHUNK
+                     : gc.sweep_end;
+    for (size_t slot = start; slot < end; slot++) {
+      PObject* object = gc.objects[slot];
+      if (object == NULL)
+        continue;
+      size_t size = p_object_size(object);
+      if (gc_is_marked(object)) {
+        worker->live += size;
+        continue;
+      }
+      gc.objects[slot] = NULL;
+      push_slot(&worker->freed, &worker->freed_count, &worker->freed_capacity,
+                slot);
+      size_t allocation_size = p_object_allocation_size(object);
+      p_object_release(object);
+      pool_batch_add(&worker->batch, object, allocation_size);
+      worker->objects_freed++;
+      worker->bytes_freed += size;
+    }
+  }
+}
+
+/**
+ * @brief Sweeps the rest of the object table on every collector thread, then
+ * returns what they freed to the pool and the free slots, and ends the
+ * collection.
+ */
+static void sweep_parallel() {
+  atomic_store_explicit(&sweep_next, gc.sweep_cursor, memory_order_relaxed);
+  run_workers(sweep_job);
+  gc.sweep_cursor = gc.sweep_end;
+
+  for (size_t i = 0; i < gc.threads; i++) {
+    GCWorker* worker = &workers[i];
+    pool_release_batch(&worker->batch);
+    for (size_t j = 0; j < worker->freed_count; j++)
+      push_slot(&gc.free_slots, &gc.free_count, &gc.free_capacity,
+                worker->freed[j]);
+    worker->freed_count = 0;
+    gc.sweep_live += worker->live;
+    gc.stats.objects_freed += worker->objects_freed;
+    gc.stats.bytes_freed += worker->bytes_freed;
+    worker->live = 0;
+    worker->objects_freed = 0;
+    worker->bytes_freed = 0;
+  }
+  gc.stats.parallel_sweeps++;
+  finish_sweep();
+}
+
+/**
+ * @brief Copies a young object to the old generation the first time it is
+ * reached, leaving the copy's address behind in the original's forward field
+ * so later references to it are redirected to the same copy. The copy is
+ * queued to have its own references promoted.
+ *
+ * @param object the young object
+ * @return PObject* the object's old copy
+ */
+static PObject* promote(PObject* object) {
+  if (object->forward != NULL)
+    return object->forward;
+  size_t size = p_object_allocation_size(object);
+  PObject* copy = pool_alloc(size);
+  memcpy(copy, object, size);
+  gc_register(copy);
+  object->forward = copy;
+
+  gc.bytes_allocated += size;
+  gc.stats.objects_promoted++;
+  gc.stats.bytes_promoted += size;
+  push_object(&gc.copied, &gc.copied_count, &gc.copied_capacity, copy);
+  // a marked object may already refer to the original, so the copy is
+  // allocated marked and traced like any other
+  if (gc.phase == GC_MARKING) {
+    set_mark(copy);
+    push_gray(copy);
+  }
+  return copy;
+}
+
+/**
+ * @brief Redirects a value holding a young object to its old copy.
+ */
+static inline void promote_value(Value* slot) {
+  if (value_is_object(*slot) && gc_is_young(value_as_object(*slot)))
+    *slot = value_new_object(promote(value_as_object(*slot)));
+}
+
+/**
+ * @brief Promotes the young objects an old object refers to. Only the types
+ * that can be young or be written to after they are created hold references
+ * that need promoting.
+ *
+ * @param object the old object
+ */
+static void promote_references(PObject* object) {
+  switch (object->type) {
+    case P_OBJ_STRUCT_INSTANCE: {
+      PStructInstance* instance = (PStructInstance*)object;
+      for (size_t i = 0; i < instance->field_count; i++)
+        promote_value(&instance->fields[i]);
+      break;
+    }
+    case P_OBJ_LIST: {
+      PList* list = (PList*)object;
+      for (size_t i = 0; i < list->count; i++)
+        promote_value(&list->values[i]);
+      break;
+    }
+    case P_OBJ_BOUND_METHOD: {
+      PBoundMethod* bound = (PBoundMethod*)object;
+      if (gc_is_young(bound->receiver))
+        bound->receiver = promote(bound->receiver);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Frees the memory owned by the young objects that were not promoted,
+ * which is only the element arrays of lists.
+ */
+static void release_nursery() {
+  uint8_t* top = gc.nursery;
+  while (top < gc.nursery_top) {
+    PObject* object = (PObject*)top;
+    size_t size = p_object_allocation_size(object);
+    if (object->forward == NULL && object->type == P_OBJ_LIST) {
+      PList* list = (PList*)object;
+      free(list->values);
+      gc.bytes_allocated -= sizeof(Value) * list->capacity;
+    }
+    top += (size + GC_ALIGNMENT - 1) & ~(size_t)(GC_ALIGNMENT - 1);
+  }
+}
+
+/**
+ * @brief Copies every young object reachable from the roots or from the old
+ * objects in the remembered set to the old generation, then empties the
+ * nursery. The old generation is not traced, anything old that refers to a
+ * young object was remembered by the write barrier when the reference was
+ * stored.
+ */
+static void promote_survivors() {
+  for (int i = 0; i < interpreter.sp; i++)
+    promote_value(&interpreter.stack[i]);
+  for (size_t i = 0; i < interpreter.global_count; i++)
+    promote_value(&interpreter.globals[i]);
+  for (size_t i = 0; i < gc.pinned_count; i++) {
+    if (gc_is_young(gc.pinned[i]))
+      gc.pinned[i] = promote(gc.pinned[i]);
+  }
+  for (size_t i = 0; i < gc.remembered_count; i++) {
+    gc.remembered[i]->remembered = false;
+    promote_references(gc.remembered[i]);
+  }
+  gc.remembered_count = 0;
+  while (gc.copied_count > 0)
+    promote_references(gc.copied[--gc.copied_count]);
+
+  release_nursery();
+#ifdef POSITRON_GC_STRESS
+  // stale references to moved objects read garbage instead of a valid copy
+  memset(gc.nursery, 0xAB, gc.nursery_top - gc.nursery);
+#endif
+  gc.nursery_top = gc.nursery;
+  if (gc.bytes_allocated > gc.stats.peak_bytes)
+    gc.stats.peak_bytes = gc.bytes_allocated;
+}
+
+/**
+ * @brief Runs a minor collection and records how long it took.
+ */
+void gc_collect_minor() {
+  double start = now();
+  promote_survivors();
+
+  double pause = now() - start;
+  gc.stats.minor_collections++;
+  gc.stats.minor_pause += pause;
+  if (pause > gc.stats.max_minor_pause)
+    gc.stats.max_minor_pause = pause;
+  record_pause(pause);
+}
+
+/**
+ * @brief Starts an incremental collection by marking the roots. The globals
+ * are only marked here, storing into one afterwards goes through
+ * gc_global_barrier().
+ */
+static void begin_marking() {
+  for (size_t i = 0; i < gc.object_capacity / 64; i++)
+    atomic_store_explicit(&gc.marks[i], 0, memory_order_relaxed);
+  mark_roots();
+  gc.phase = GC_MARKING;
+  gc.slice_debt = 0;
+}
+
+/**
+ * @brief Promotes the young objects still alive and marks the roots written
+ * without barriers again. Marking is finished once everything this reaches
+ * has been traced without the program running in between.
+ */
+static void rescan_roots() {
+  if (gc.nursery_top != gc.nursery)
+    promote_survivors();
+  mark_stack_roots();
+}
+
+/**
+ * @brief Starts the sweep once marking is finished. Unmarked strings are
+ * dropped from the intern table now, since the sweep may not free them for a
+ * while and they must not be found again in the meantime.
+ */
+static void begin_sweeping() {
+  string_table_remove_unmarked(&interpreter.strings);
+
+  gc.sweep_cursor = 0;
+  gc.sweep_end = gc.object_count;
+  gc.sweep_start = gc.bytes_allocated;
+  gc.sweep_live = 0;
+  gc.phase = GC_SWEEPING;
+}
+
+/**
+ * @brief Finishes marking at once and starts the sweep.
+ */
+static void finish_marking() {
+  rescan_roots();
+  trace_references();
+  begin_sweeping();
+}
+
+/**
+ * @brief Empties the nursery, then marks every object reachable from the
+ * roots and frees the rest, picking up where an incremental collection in
+ * progress left off. Large heaps are marked and swept on every collector
+ * thread. The next collection happens once the heap has grown by
+ * GC_HEAP_GROW_FACTOR over what survived this one.
+ */
+void gc_collect() {
+  gc_collect_minor();
+
+  double start = now();
+  if (gc.phase == GC_IDLE)
+    begin_marking();
+  if (gc.phase == GC_MARKING)
+    finish_marking();
+  if (gc.threads > 1 &&
+      gc.sweep_end - gc.sweep_cursor >= GC_PARALLEL_MIN_OBJECTS)
+    sweep_parallel();
+  else
+    sweep_slice(SIZE_MAX, INFINITY);
+
+  double pause = now() - start;
+  gc.stats.total_pause += pause;
+  if (pause > gc.stats.max_pause)
+    gc.stats.max_pause = pause;
+  record_pause(pause);
+}
+
+/**
+ * @brief Runs a slice of the incremental collection in progress once
+ * GC_SLICE_BYTES have been allocated since the last one. A slice traces or
+ * sweeps GC_SLICE_RATIO times as many bytes of objects as were allocated,
+ * stopping early at the maximum pause. The slice that empties the gray stack
+ * rescans the roots without barriers and keeps tracing what they reach, and
+ * only starts the sweep if that also finishes before the deadline. Otherwise
+ * a later slice traces the rest and rescans again, so no slice runs much past
+ * the maximum pause apart from the promotion of the nursery's survivors.
+ *
+ * @param size the bytes about to be allocated
+ */
+void gc_step(size_t size) {
+  gc.slice_debt += size;
+  if (gc.slice_debt < GC_SLICE_BYTES || gc.paused > 0)
+    return;
+  gc.slice_debt = 0;
+
+  double start = now();
+  double deadline = start + gc.max_pause;
+#ifdef POSITRON_GC_STRESS
+  // trace or sweep a few objects, enough to keep up with the objects every
+  // allocation promotes but still spreading collections over many slices
+  size_t budget = 256;
+#else
+  size_t budget = GC_SLICE_BYTES * GC_SLICE_RATIO;
+#endif
+  if (gc.phase == GC_MARKING) {
+    if (mark_slice(budget, deadline)) {
+      rescan_roots();
+      if (mark_slice(budget, deadline))
+        begin_sweeping();
+    }
+  } else {
+    sweep_slice(budget, deadline);
+  }
+
+  double pause = now() - start;
+  gc.stats.slices++;
+  gc.stats.slice_pause += pause;
+  if (pause > gc.stats.max_slice_pause)
+    gc.stats.max_slice_pause = pause;
+  record_pause(pause);
+}
+
+/**
+ * @brief Prints how much the collector ran and freed to stderr.
+ */
+void gc_print_stats() {
+  fprintf(stderr,
+          "gc: %llu minor collections, %llu objects promoted (%.2f MB), "
+          "%.3fms total pause, %.3fms max pause\n",
+          (unsigned long long)gc.stats.minor_collections,
+          (unsigned long long)gc.stats.objects_promoted,
+          gc.stats.bytes_promoted / (1024.0 * 1024.0),
+          gc.stats.minor_pause * 1e3, gc.stats.max_minor_pause * 1e3);
+  fprintf(stderr,
+          "gc: %llu full collections, %llu objects freed (%.2f MB), "
+          "%.3fms total pause, %.3fms max pause\n",
+          (unsigned long long)gc.stats.collections,
+          (unsigned long long)gc.stats.objects_freed,
+          gc.stats.bytes_freed / (1024.0 * 1024.0),
+          gc.stats.total_pause * 1e3, gc.stats.max_pause * 1e3);
+  if (gc.stats.slices > 0)
+    fprintf(stderr,
+            "gc: %llu incremental slices, %.3fms total pause, "
+            "%.3fms max pause\n",
+            (unsigned long long)gc.stats.slices, gc.stats.slice_pause * 1e3,
+            gc.stats.max_slice_pause * 1e3);
+  if (gc.stats.parallel_marks > 0 || gc.stats.parallel_sweeps > 0)
+    fprintf(stderr,
+            "gc: %llu parallel marks, %llu parallel sweeps on %zu threads, "
+            "%llu objects stolen\n",
+            (unsigned long long)gc.stats.parallel_marks,
+            (unsigned long long)gc.stats.parallel_sweeps, gc.threads,
+            (unsigned long long)gc.stats.objects_stolen);
+  fprintf(stderr, "gc: %.2f MB peak heap\n",
+          gc.stats.peak_bytes / (1024.0 * 1024.0));
+  for (size_t i = 0; i < GC_PAUSE_BUCKETS; i++) {
+    if (gc.stats.pauses[i] == 0)
+      continue;
+    if (i < GC_PAUSE_BUCKETS - 1)
+      fprintf(stderr, "gc: %10llu pauses under %gms\n",
+              (unsigned long long)gc.stats.pauses[i], pause_buckets[i]);
+    else
+      fprintf(stderr, "gc: %10llu pauses over %gms\n",
+              (unsigned long long)gc.stats.pauses[i], pause_buckets[i - 1]);
+  }
+}
+
+/**
+ * @brief Frees the collector's memory along with every object, stopping its
+ * threads first. The old objects go back to the pool, which must be freed
+ * afterwards.
+ */
+void gc_free() {
+  pthread_mutex_lock(&workers_lock);
+  workers_stopping = true;
+  pthread_cond_broadcast(&workers_start);
+  pthread_mutex_unlock(&workers_lock);
+  for (size_t i = 1; i <= workers_started; i++)
+    pthread_join(workers[i].thread, NULL);
+  workers_started = 0;
+  workers_stopping = false;
+  for (size_t i = 0; i < GC_MAX_THREADS; i++) {
+    free(workers[i].freed);
+    workers[i].freed = NULL;
+    workers[i].freed_count = 0;
+    workers[i].freed_capacity = 0;
+  }
+
+  for (size_t i = 0; i < gc.object_count; i++) {
+    if (gc.objects[i] != NULL)
+      p_object_free(gc.objects[i]);
+  }
+  free(gc.objects);
+  gc.objects = NULL;
+  gc.object_count = 0;
+  gc.object_capacity = 0;
+  free((void*)gc.marks);
+  gc.marks = NULL;
+  free(gc.free_slots);
+  gc.free_slots = NULL;
+  gc.free_count = 0;
+  gc.free_capacity = 0;
+
+  release_nursery();
+  free(gc.nursery);
+  gc.nursery = gc.nursery_top = gc.nursery_end = NULL;
+  free(gc.remembered);
+  gc.remembered = NULL;
+  gc.remembered_count = 0;
+  free(gc.copied);
+  gc.copied = NULL;
+  gc.copied_count = 0;
+  gc.copied_capacity = 0;
+  free(gc.gray);
+  gc.gray = NULL;
+  gc.gray_count = 0;
+  gc.gray_capacity = 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * @file gc.h
+ * @author Devin Arena
+ * @brief Tracing mark and sweep garbage collector for the interpreter heap.
+ * @since 10/16/2026
+ **/
+
+#ifndef POSITRON_GC_H
+#define POSITRON_GC_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hash_table.h"
+#include "object.h"
+#include "value.h"
+
+// the heap may grow to this many times its live size before collecting again
+#define GC_HEAP_GROW_FACTOR 2
+// no collection happens before the heap reaches this many bytes
+#define GC_MIN_HEAP (1024 * 1024)
+// most objects C code can pin as roots at once
+#define GC_MAX_PINNED 16
+// size of the nursery young objects are bump allocated in
+#define GC_NURSERY_SIZE (1024 * 1024)
+// objects larger than this are allocated in the old generation directly
+#define GC_LARGE_OBJECT 1024
+// alignment of objects in the nursery
+#define GC_ALIGNMENT 16
+// bytes allocated between two slices of an incremental collection
+#define GC_SLICE_BYTES (64 * 1024)
+// bytes of objects a slice traces or sweeps for every byte allocated, enough
+// for a collection to finish long before the heap doubles
+#define GC_SLICE_RATIO 4
+// buckets of the pause time histogram, see gc_print_stats()
+#define GC_PAUSE_BUCKETS 11
+// most threads a full collection marks and sweeps with
+#define GC_MAX_THREADS 64
+// objects each marking thread's deque holds before it spills to a shared
+// stack, must be a power of two
+#define GC_DEQUE_SIZE 4096
+// slots of the object table a sweeping thread claims at a time
+#define GC_SWEEP_CHUNK 4096
+// smaller heaps are marked and swept on the main thread alone, waking the
+// other threads would take longer
+#ifdef POSITRON_GC_STRESS
+#define GC_PARALLEL_MIN_OBJECTS 0
+#else
+#define GC_PARALLEL_MIN_OBJECTS (64 * 1024)
+#endif
+
+// what a collection in progress is doing, full collections go through every
+// phase at once while incremental ones spread them over many slices
+typedef enum GCPhase {
+  GC_IDLE,
+  // the gray stack holds objects still to be traced
+  GC_MARKING,
+  // unmarked objects are being freed from the object table
+  GC_SWEEPING,
+} GCPhase;
+
+typedef struct GCStats {
+  uint64_t minor_collections;
+  uint64_t objects_promoted;
+  uint64_t bytes_promoted;
+  double minor_pause;
+  double max_minor_pause;
+  uint64_t collections;
+  uint64_t objects_freed;
+  uint64_t bytes_freed;
+  size_t peak_bytes;
+  double total_pause;
+  double max_pause;
+  uint64_t slices;
+  double slice_pause;
+  double max_slice_pause;
+  // every minor collection, full collection and slice by how long it paused
+  uint64_t pauses[GC_PAUSE_BUCKETS];
+  uint64_t parallel_marks;
+  uint64_t parallel_sweeps;
+  uint64_t objects_stolen;
+} GCStats;
+
+typedef struct GC {
+  // young objects are bump allocated between nursery and nursery_end, the
+  // ones that survive a minor collection are copied to the old generation
+  uint8_t* nursery;
+  uint8_t* nursery_top;
+  uint8_t* nursery_end;
+  // old objects that may refer to young objects, see gc_write_barrier()
+  PObject** remembered;
+  size_t remembered_count;
+  size_t remembered_capacity;
+  // young objects a minor collection has copied but not scanned yet
+  PObject** copied;
+  size_t copied_count;
+  size_t copied_capacity;
+  // every old object by its slot, freed slots are NULL until reused
+  PObject** objects;
+  size_t object_count;
+  size_t object_capacity;
+  size_t* free_slots;
+  size_t free_count;
+  size_t free_capacity;
+  // one bit per slot, set once a collection finds the slot's object
+  // reachable. Keeping them apart from the objects lets marking threads set
+  // them atomically without writing to the objects
+  _Atomic uint64_t* marks;
+  // estimated bytes held by live and unreachable old objects
+  size_t bytes_allocated;
+  // collect once bytes_allocated would exceed this
+  size_t next_gc;
+  // while above zero the old generation is not collected, see gc_pause()
+  size_t paused;
+  // marked objects whose references have not been traced yet
+  PObject** gray;
+  size_t gray_count;
+  size_t gray_capacity;
+  // whether collections are split into slices interleaved with allocation
+  bool incremental;
+  // seconds after which a slice stops early
+  double max_pause;
+  GCPhase phase;
+  // bytes allocated since the last slice
+  size_t slice_debt;
+  // the sweep frees the unmarked objects in slots sweep_cursor up to
+  // sweep_end, objects allocated while it runs get slots past sweep_end
+  size_t sweep_cursor;
+  size_t sweep_end;
+  // bytes_allocated when the sweep started, and the bytes it found alive
+  size_t sweep_start;
+  size_t sweep_live;
+  // objects only referenced from C locals, see gc_pin()
+  PObject* pinned[GC_MAX_PINNED];
+  size_t pinned_count;
+  // threads full collections of large heaps mark and sweep with, counting
+  // the main thread
+  size_t threads;
+  GCStats stats;
+} GC;
+
+extern GC gc;
+
+// initializes the collector's state.
+void gc_init();
+// records bytes allocated outside of an object allocation, such as the
+// elements of a list.
+void gc_track(size_t bytes);
+// collects before allocating an old object of size bytes if the heap has
+// grown past the threshold, then records the allocation.
+void gc_allocate(size_t size);
+// bump allocates a young object of size bytes in the nursery, running a minor
+// collection first if it is full.
+PObject* gc_allocate_young(size_t size);
+// gives a new old object a slot in the object table.
+void gc_register(PObject* object);
+// records that an old object may now refer to young objects.
+void gc_remember(PObject* object);
+// copies the young objects that are still reachable to the old generation
+// and empties the nursery.
+void gc_collect_minor();
+// empties the nursery, then marks all reachable objects and frees the rest,
+// finishing an incremental collection in progress.
+void gc_collect();
+// runs the next slice of an incremental collection once enough has been
+// allocated since the last one.
+void gc_step(size_t size);
+// marks an object as reachable, NULL is ignored.
+void gc_mark_object(PObject* object);
+// marks the object held by a value, if any.
+void gc_mark_value(Value value);
+// marks every key and value in a table.
+void gc_mark_table(HashTable* table);
+// keeps an object only referenced by C code alive until gc_unpin().
+void gc_pin(PObject* object);
+// releases the count most recently pinned objects.
+void gc_unpin(size_t count);
+// stops collecting the old generation until the matching gc_resume().
+void gc_pause();
+// lets collections of the old generation run again after gc_pause().
+void gc_resume();
+// prints the collection statistics to stderr.
+void gc_print_stats();
+// frees the collector's memory and every object.
+void gc_free();
+
+// whether an object lives in the nursery
+static inline bool gc_is_young(PObject* object) {
+  return (uint8_t*)object >= gc.nursery && (uint8_t*)object < gc.nursery_end;
+}
+
+// whether the current collection has found an old object reachable
+static inline bool gc_is_marked(PObject* object) {
+  uint64_t word = atomic_load_explicit(&gc.marks[object->slot / 64],
+                                       memory_order_relaxed);
+  return (word >> (object->slot % 64)) & 1;
+}
+
+// marks an object stored where an incremental collection will not look for
+// it again, such as in a global
+static inline void gc_shade(PObject* object) {
+  if (gc.phase == GC_MARKING)
+    gc_mark_object(object);
+}
+
+// must be called whenever a value is stored into a global
+static inline void gc_global_barrier(Value value) {
+  if (value_is_object(value))
+    gc_shade(value_as_object(value));
+}
+
+// must be called whenever a value is stored into an object that already
+// exists, so minor collections can find young objects only old ones refer to
+// and incremental collections never leave an object only a marked one
+// refers to unmarked
+static inline void gc_write_barrier(PObject* owner, Value value) {
+  if (!value_is_object(value))
+    return;
+  PObject* object = value_as_object(value);
+  if (gc_is_young(object)) {
+    if (!gc_is_young(owner) && !owner->remembered)
+      gc_remember(owner);
+  } else if (gc.phase == GC_MARKING && !gc_is_young(owner) &&
+             gc_is_marked(owner)) {
+    gc_mark_object(object);
+  }
+}
+
+#endif
@@ -1,4 +1,3 @@
-
 /**
  * @file table.c
  * @author Devin Arena
@@ -10,10 +9,34 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "gc.h"
 #include "hash_table.h"
+#include "object.h"
 
-// max load before table resizes
+// max load, counting tombstones, before the table is rehashed
 #define TABLE_MAX_LOAD 0.75
+// load below which a table shrinks after a delete, low enough that a table
+// that just doubled does not shrink straight back
+#define TABLE_MIN_LOAD 0.125
+// smallest capacity a table is given or shrunk to
+#define TABLE_MIN_CAPACITY 8
+
+#ifdef POSITRON_PROFILE
+HashTableStats hash_table_stats;
+
+/**
+ * @brief Records how many slots a lookup, insert or delete examined.
+ */
+static inline void record_probes(int probes) {
+  hash_table_stats.lookups++;
+  hash_table_stats.probes += probes;
+  if (probes > hash_table_stats.longest_probe)
+    hash_table_stats.longest_probe = probes;
+}
+#define RECORD_PROBES(probes) record_probes(probes)
+#else
+#define RECORD_PROBES(probes) ((void)(probes))
+#endif
 
 /**
  * @brief Initializes a table by zeroing out all of its memory.
@@ -22,12 +45,15 @@
  */
 void hash_table_init(HashTable* table) {
   table->count = 0;
+  table->tombstones = 0;
   table->capacity = 0;
   table->entries = NULL;
 }
 
 /**
- * @brief Frees a table by freeing its entries and zeroing its memory.
+ * @brief Frees a table's entries and zeroes its memory. Keys are interned
+ * strings owned by the heap and values are stored inline, so there is nothing
+ * else to free.
  *
  * @param table Table* the table to free.
  */
@@ -36,80 +62,116 @@ void hash_table_free(HashTable* table) {
   hash_table_init(table);
 }
 
+static void place_entry(Entry* entries, int capacity, Entry entry);
+
+/**
+ * @brief Rehashes the table into a new entries array of the given capacity,
+ * copying only the live entries, which drops every tombstone.
+ *
+ * @param table Table* the table to adjust.
+ * @param capacity int the new capacity of the table, a power of two.
+ */
+static void adjustCapacity(HashTable* table, int capacity) {
+  Entry* entries = malloc(sizeof(Entry) * capacity);
+  if (!entries) {
+    printf("Failed to allocate memory for a hash table.\n");
+    exit(1);
+  }
+  for (int i = 0; i < capacity; i++) {
+    entries[i].key = NULL;
+    entries[i].hash = 0;
+    entries[i].value = value_new_null();
+  }
+
+  // start just past an empty slot so entries are moved over in the order of
+  // their probe sequences, which saves most of the displacing when they are
+  // placed again
+  int start = 0;
+  while (start < table->capacity && table->entries[start].key != NULL)
+    start++;
+  for (int i = 0; i < table->capacity; i++) {
+    Entry* entry = &table->entries[(start + i) & (table->capacity - 1)];
+    if (entry->key != NULL)
+      place_entry(entries, capacity, *entry);
+  }
+
+  free(table->entries);
+
+  table->entries = entries;
+  table->capacity = capacity;
+  table->tombstones = 0;
+}
+
 /**
- * @brief Takes the hash of the key and searches the array for it, if it doesnt
- * find it, it linear searches from that position.
+ * @brief Halves the table's capacity once a delete leaves it sparse.
+ */
+static void shrink_if_sparse(HashTable* table) {
+  if (table->capacity > TABLE_MIN_CAPACITY &&
+      table->count < table->capacity * TABLE_MIN_LOAD)
+    adjustCapacity(table, table->capacity / 2);
+}
+
+#ifdef POSITRON_HASH_LINEAR
+
+/**
+ * @brief Searches the entries for a key, starting at the slot its hash maps
+ * to and probing linearly. Keys are interned so they compare by pointer.
+ * Returns the entry holding the key, or the slot the key would be inserted
+ * into (the first tombstone passed, otherwise the empty slot that ended the
+ * search).
  *
  * @param entries Entry* the array of entries to search.
  * @param capacity int the capacity of the array.
- * @param key PdString* the key to search for.
+ * @param key PString* the key to search for.
  * @return Entry* the entry that was found.
  */
-static Entry* findEntry(Entry* entries, int capacity, const char* key) {
-  uint32_t index = (HASH_STRING(key) & (capacity - 1));
+static Entry* findEntry(Entry* entries, int capacity, PString* key) {
+  uint32_t index = key->hash & (capacity - 1);
   Entry* tombstone = NULL;
+  int probes = 1;
 
   while (true) {
     Entry* entry = &entries[index];
 
+    if (entry->key == key) {
+      RECORD_PROBES(probes);
+      return entry;
+    }
     if (entry->key == NULL) {
-      if (entry->value == NULL) {
+      // an empty entry holds null, a tombstone holds true
+      if (value_is_null(entry->value)) {
+        RECORD_PROBES(probes);
         return tombstone != NULL ? tombstone : entry;
-      } else {
-        if (tombstone == NULL)
-          tombstone = entry;
       }
-    } else if (strcmp(entry->key, key) == 0) {
-      return entry;
+      if (tombstone == NULL)
+        tombstone = entry;
     }
 
     index = (index + 1) & (capacity - 1);
+    probes++;
   }
-
-  return NULL;
 }
 
 /**
- * @brief Adjusts the capacity of the table by creating a new entries array and
- * copying the old entries into it.
- *
- * @param table Table* the table to adjust.
- * @param capacity int the new capacity of the table.
+ * @brief Places an entry in a new entries array, which has no tombstones and
+ * no duplicate keys, so the first empty slot of its probe sequence will do.
  */
-static void adjustCapacity(HashTable* table, int capacity) {
-  Entry* entries = malloc(sizeof(Entry) * capacity);
-  for (int i = 0; i < capacity; i++) {
-    entries[i].key = NULL;
-    entries[i].value = NULL;
-  }
-
-  table->count = 0;
-  for (int i = 0; i < table->capacity; i++) {
-    Entry* entry = &table->entries[i];
-    if (entry->key == NULL)
-      continue;
-
-    Entry* dest = findEntry(entries, capacity, entry->key);
-    dest->key = entry->key;
-    dest->value = entry->value;
-    table->count++;
-  }
-
-  free(table->entries);
-
-  table->entries = entries;
-  table->capacity = capacity;
+static void place_entry(Entry* entries, int capacity, Entry entry) {
+  uint32_t index = entry.hash & (capacity - 1);
+  while (entries[index].key != NULL)
+    index = (index + 1) & (capacity - 1);
+  entries[index] = entry;
 }
 
 /**
- * @brief Gets a value from the table by searching for the key. Assigns the
- * value to the value pointer. If the key is not found, it returns false.
+ * @brief Gets a value from the table by searching for the key.
  *
  * @param table Table* the table to search.
- * @param key const char* the key to search for.
- * @return Value* a pointer to the value or NULL if the key is not found.
+ * @param key PString* the key to search for.
+ * @return Value* a pointer to the value in the table, valid until the table
+ * is next modified, or NULL if the key is not found.
  */
-Value* hash_table_get(HashTable* table, const char* key) {
+Value* hash_table_get(HashTable* table, PString* key) {
   if (table->count == 0)
     return NULL;
 
@@ -117,68 +179,55 @@ Value* hash_table_get(HashTable* table, const char* key) {
   if (entry->key == NULL)
     return NULL;
 
-  return entry->value;
-}
-
-/**
- * @brief Gets a value from the table by searching for the key. Assigns the
- * value to the value pointer. If the key is not found, it returns false.
- *
- * @param table Table* the table to search.
- * @param key_start const char* the key to search for.
- * @param length size_t the length of the key
- * @return Value* a pointer to the value or NULL if the key is not found.
-*/
-Value* hash_table_get_n(HashTable* table, const char* key_start, size_t length) {
-  char buffer[200];
-  if (length > 200)
-    return NULL;
-
-  memcpy(buffer, key_start, length);
-  buffer[length] = '\0';
-  return hash_table_get(table, buffer);
+  return &entry->value;
 }
 
 /**
- * @brief Sets a value in the table, incrementing the count if the key is not in
- * the table. Adjusts the capacity if the load factor is greater than the max
- * load.
+ * @brief Sets a value in the table. Tombstones lengthen probe sequences just
+ * like live entries, so once live entries and tombstones together pass the
+ * max load the table is rehashed: into double the capacity if the live
+ * entries alone need it, otherwise in place to clear the tombstones.
  *
  * @param table Table* the table to set the value in.
- * @param key PdString* the key to set the value for.
+ * @param key PString* the key to set the value for.
  * @param value Value the value to set.
- * @return bool true if the key is not found, false otherwise.
+ * @return bool true if the key is new, false if an existing value was
+ * replaced.
  */
-bool hash_table_set(HashTable* table, const char* key, Value* value) {
-  if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
-    int capacity = table->capacity < 8 ? 8 : table->capacity * 2;
+bool hash_table_set(HashTable* table, PString* key, Value value) {
+  if (table->count + table->tombstones + 1 >
+      table->capacity * TABLE_MAX_LOAD) {
+    int capacity = table->capacity < TABLE_MIN_CAPACITY ? TABLE_MIN_CAPACITY
+                                                        : table->capacity;
+    // grow when the live entries fill over half of the max load
+    if (table->count + 1 > capacity * TABLE_MAX_LOAD / 2)
+      capacity *= 2;
     adjustCapacity(table, capacity);
   }
 
   Entry* entry = findEntry(table->entries, table->capacity, key);
   bool isNewKey = entry->key == NULL;
-  if (isNewKey && entry->value == NULL)
-    table->count++;
-
   if (isNewKey) {
-    entry->key = strdup(key);
+    if (!value_is_null(entry->value))
+      table->tombstones--;
+    table->count++;
   }
 
-  if (entry->value != NULL)
-    value_free(entry->value);
-  entry->value = value_clone(value);
-
+  entry->key = key;
+  entry->hash = key->hash;
+  entry->value = value;
   return isNewKey;
 }
 
 /**
- * @brief Deletes an entry from the table by setting it to be a tombstone.
+ * @brief Deletes an entry from the table by turning it into a tombstone, and
+ * shrinks the table once it becomes sparse.
  *
  * @param table Table* the table to delete the entry from.
- * @param key PdString* the key to delete.
+ * @param key PString* the key to delete.
  * @return bool true if the key was found, false otherwise.
  */
-bool hash_table_delete(HashTable* table, const char* key) {
+bool hash_table_delete(HashTable* table, PString* key) {
   if (table->count == 0)
     return false;
 
@@ -186,63 +235,217 @@ bool hash_table_delete(HashTable* table, const char* key) {
   if (entry->key == NULL)
     return false;
 
-  if (entry->value != NULL)
-    value_free(entry->value);
+  entry->key = NULL;
+  entry->value = value_new_boolean(true);
+  table->count--;
+  table->tombstones++;
 
-  Value* copy = value_clone(&value_new_null());
-  copy->data.number = -1;
-  entry->value = copy;  // tombstone
+  shrink_if_sparse(table);
   return true;
 }
 
+#else
+
 /**
- * @brief Copies all entires from one table to another.
+ * @brief Gets how far the entry at index sits from the slot its hash maps to.
+ */
+static inline uint32_t probe_distance(uint32_t hash,
+                                      uint32_t index,
+                                      int capacity) {
+  return (index - hash) & (capacity - 1);
+}
+
+/**
+ * @brief Searches the entries for a key with Robin Hood probing. Insertion
+ * keeps every probe sequence ordered so no entry sits further from its slot
+ * than the entry it displaced, which lets a search stop at the first entry
+ * closer to its own slot than the key would be, instead of running on to an
+ * empty slot.
  *
- * @param from Table* the table to copy from.
- * @param to Table* the table to copy to.
+ * @param entries Entry* the array of entries to search.
+ * @param capacity int the capacity of the array.
+ * @param key PString* the key to search for.
+ * @return Entry* the entry holding the key or NULL if it is not found.
  */
-void hash_table_add_all(HashTable* from, HashTable* to) {
-  for (int i = 0; i < from->capacity; i++) {
-    Entry* entry = &from->entries[i];
-    if (entry->key == NULL)
-      continue;
+static Entry* findEntry(Entry* entries, int capacity, PString* key) {
+  uint32_t index = key->hash & (capacity - 1);
+  uint32_t distance = 0;
 
-    hash_table_set(to, entry->key, entry->value);
+  while (true) {
+    Entry* entry = &entries[index];
+
+    if (entry->key == key) {
+      RECORD_PROBES(distance + 1);
+      return entry;
+    }
+    if (entry->key == NULL ||
+        probe_distance(entry->hash, index, capacity) < distance) {
+      RECORD_PROBES(distance + 1);
+      return NULL;
+    }
+
+    index = (index + 1) & (capacity - 1);
+    distance++;
   }
 }
 
 /**
- * @brief Searches the table for a string with the specified hash, characters,
- * and length.
+ * @brief Continues placing an entry whose key is not in the entries yet from
+ * the given slot and distance. Walking the probe sequence, the entry takes
+ * the slot of the first entry closer to its own slot than the entry being
+ * placed, and the displaced entry carries on looking for a slot in its place.
+ */
+static void place_entry_from(Entry* entries,
+                             int capacity,
+                             Entry entry,
+                             uint32_t index,
+                             uint32_t distance) {
+  while (entries[index].key != NULL) {
+    uint32_t existing = probe_distance(entries[index].hash, index, capacity);
+    if (existing < distance) {
+      Entry displaced = entries[index];
+      entries[index] = entry;
+      entry = displaced;
+      distance = existing;
+    }
+    index = (index + 1) & (capacity - 1);
+    distance++;
+  }
+  entries[index] = entry;
+}
+
+/**
+ * @brief Inserts an entry whose key is not in the entries yet, starting from
+ * the slot its hash maps to.
+ */
+static void place_entry(Entry* entries, int capacity, Entry entry) {
+  place_entry_from(entries, capacity, entry, entry.hash & (capacity - 1), 0);
+}
+
+/**
+ * @brief Gets a value from the table by searching for the key.
  *
  * @param table Table* the table to search.
- * @param chars char* the characters to search for.
- * @param length int the length of the string.
- * @param hash uint32_t the hash of the string.
- * @return PdString* the string that was found or NULL.
+ * @param key PString* the key to search for.
+ * @return Value* a pointer to the value in the table, valid until the table
+ * is next modified, or NULL if the key is not found.
  */
-char* hash_table_find_string(HashTable* table,
-                                   const char* chars,
-                                   size_t length,
-                                   uint32_t hash) {
+Value* hash_table_get(HashTable* table, PString* key) {
   if (table->count == 0)
     return NULL;
 
-  uint32_t index = hash & (table->capacity - 1);
+  Entry* entry = findEntry(table->entries, table->capacity, key);
+  return entry != NULL ? &entry->value : NULL;
+}
+
+/**
+ * @brief Sets a value in the table, doubling the capacity before a new key
+ * would pass the max load. A single walk of the probe sequence either finds
+ * the key and replaces its value, or reaches the point where the key would
+ * have been placed and inserts it there.
+ *
+ * @param table Table* the table to set the value in.
+ * @param key PString* the key to set the value for.
+ * @param value Value the value to set.
+ * @return bool true if the key is new, false if an existing value was
+ * replaced.
+ */
+bool hash_table_set(HashTable* table, PString* key, Value value) {
+  if (table->count + 1 > table->capacity * TABLE_MAX_LOAD)
+    adjustCapacity(table, table->capacity < TABLE_MIN_CAPACITY
+                              ? TABLE_MIN_CAPACITY
+                              : table->capacity * 2);
+
+  Entry* entries = table->entries;
+  int capacity = table->capacity;
+  uint32_t index = key->hash & (capacity - 1);
+  uint32_t distance = 0;
 
   while (true) {
-    Entry* entry = &table->entries[index];
+    Entry* entry = &entries[index];
 
-    if (entry->key == NULL) {
-      if (entry->value == NULL)
-        return NULL;
-    } else if (strlen(entry->key) == length &&
-               HASH_STRING(entry->key) == hash &&
-               memcmp(entry->key, chars, length) == 0) {
-      return entry->key;
+    if (entry->key == key) {
+      RECORD_PROBES(distance + 1);
+      entry->value = value;
+      return false;
+    }
+    if (entry->key == NULL ||
+        probe_distance(entry->hash, index, capacity) < distance) {
+      RECORD_PROBES(distance + 1);
+      break;
     }
 
-    index = (index + 1) & (table->capacity - 1);
+    index = (index + 1) & (capacity - 1);
+    distance++;
+  }
+
+  // the key is not in the table and belongs at index, displacing the rest of
+  // the probe sequence if the slot is taken
+  Entry entry = {.key = key, .hash = key->hash, .value = value};
+  if (entries[index].key == NULL) {
+    entries[index] = entry;
+  } else {
+    Entry displaced = entries[index];
+    entries[index] = entry;
+    place_entry_from(entries, capacity, displaced, (index + 1) & (capacity - 1),
+                     probe_distance(displaced.hash, index, capacity) + 1);
+  }
+  table->count++;
+  return true;
+}
+
+/**
+ * @brief Deletes an entry from the table. Rather than leaving a tombstone,
+ * the entries after it in the probe sequence shift back one slot until one
+ * is already in its own slot, so deletes never lengthen future probes. Shrinks
+ * the table once it becomes sparse.
+ *
+ * @param table Table* the table to delete the entry from.
+ * @param key PString* the key to delete.
+ * @return bool true if the key was found, false otherwise.
+ */
+bool hash_table_delete(HashTable* table, PString* key) {
+  if (table->count == 0)
+    return false;
+
+  Entry* entry = findEntry(table->entries, table->capacity, key);
+  if (entry == NULL)
+    return false;
+
+  uint32_t index = entry - table->entries;
+  while (true) {
+    uint32_t next = (index + 1) & (table->capacity - 1);
+    Entry* following = &table->entries[next];
+    if (following->key == NULL ||
+        probe_distance(following->hash, next, table->capacity) == 0)
+      break;
+    table->entries[index] = *following;
+    index = next;
+  }
+  table->entries[index].key = NULL;
+  table->entries[index].hash = 0;
+  table->entries[index].value = value_new_null();
+  table->count--;
+
+  shrink_if_sparse(table);
+  return true;
+}
+
+#endif
+
+/**
+ * @brief Copies all entires from one table to another.
+ *
+ * @param from Table* the table to copy from.
+ * @param to Table* the table to copy to.
+ */
+void hash_table_add_all(HashTable* from, HashTable* to) {
+  for (int i = 0; i < from->capacity; i++) {
+    Entry* entry = &from->entries[i];
+    if (entry->key == NULL)
+      continue;
+
+    hash_table_set(to, entry->key, entry->value);
   }
 }
 
@@ -254,6 +457,7 @@ char* hash_table_find_string(HashTable* table,
 void hash_table_print(HashTable* table) {
   printf("table: %p\n", table);
   printf(" count: %d\n", table->count);
+  printf(" tombstones: %d\n", table->tombstones);
   printf(" capacity: %d\n", table->capacity);
   printf(" entries: %p\n", table->entries);
   printf(" entries: [\n");
@@ -261,14 +465,141 @@ void hash_table_print(HashTable* table) {
     Entry* entry = &table->entries[i];
     if (entry->key) {
       printf("  {\n");
-      printf("  key (%p): %s\n", entry->key, entry->key);
-      printf("  value (%p): ", entry->value);
-      if (entry->value)
-        value_print(entry->value);
-      else
-        printf("%p", entry->value);
+      printf("  key (%p): %s\n", entry->key, entry->key->value);
+      printf("  value: ");
+      value_print(&entry->value);
       printf("\n  }\n");
     }
   }
   printf("]\n");
-}
\ No newline at end of file
+}
+
+// marks a string table slot whose string was removed, so probing continues
+// past it
+static PString string_tombstone;
+#define STRING_TOMBSTONE (&string_tombstone)
+
+/**
+ * @brief Initializes an empty string table.
+ *
+ * @param table StringTable* the table to initialize.
+ */
+void string_table_init(StringTable* table) {
+  table->count = 0;
+  table->tombstones = 0;
+  table->capacity = 0;
+  table->entries = NULL;
+}
+
+/**
+ * @brief Frees a string table's slots. The strings themselves are owned by
+ * the heap, the table only refers to them.
+ *
+ * @param table StringTable* the table to free.
+ */
+void string_table_free(StringTable* table) {
+  free(table->entries);
+  string_table_init(table);
+}
+
+/**
+ * @brief Finds an interned string with the given characters.
+ *
+ * @param table StringTable* the table to search.
+ * @param chars const char* the characters of the string.
+ * @param length size_t the length of the string.
+ * @param hash uint32_t the hash of the characters.
+ * @return PString* the interned string or NULL if there is none.
+ */
+PString* string_table_find(StringTable* table,
+                           const char* chars,
+                           size_t length,
+                           uint32_t hash) {
+  if (table->capacity == 0)
+    return NULL;
+
+  uint32_t index = hash & (table->capacity - 1);
+  while (true) {
+    PString* string = table->entries[index];
+    if (string == NULL)
+      return NULL;
+    if (string != STRING_TOMBSTONE && string->hash == hash &&
+        string->length == length &&
+        memcmp(string->value, chars, length) == 0)
+      return string;
+
+    index = (index + 1) & (table->capacity - 1);
+  }
+}
+
+/**
+ * @brief Places a string in the first free or tombstone slot of its probe
+ * sequence.
+ *
+ * @return bool true if the slot was empty rather than a tombstone.
+ */
+static bool string_table_insert(PString** entries,
+                                int capacity,
+                                PString* string) {
+  uint32_t index = string->hash & (capacity - 1);
+  while (entries[index] != NULL && entries[index] != STRING_TOMBSTONE)
+    index = (index + 1) & (capacity - 1);
+  bool empty = entries[index] == NULL;
+  entries[index] = string;
+  return empty;
+}
+
+/**
+ * @brief Adds a string that is not interned yet. Like the hash table, the
+ * string table is rehashed once live strings and tombstones pass the max
+ * load, growing only when the live strings need the room.
+ *
+ * @param table StringTable* the table to add to.
+ * @param string PString* the string to intern.
+ */
+void string_table_add(StringTable* table, PString* string) {
+  if (table->count + table->tombstones + 1 >
+      table->capacity * TABLE_MAX_LOAD) {
+    int capacity = table->capacity < TABLE_MIN_CAPACITY ? TABLE_MIN_CAPACITY
+                                                        : table->capacity;
+    if (table->count + 1 > capacity * TABLE_MAX_LOAD / 2)
+      capacity *= 2;
+    PString** entries = calloc(capacity, sizeof(PString*));
+    if (!entries) {
+      printf("Failed to allocate memory for the string table.\n");
+      exit(1);
+    }
+    for (int i = 0; i < table->capacity; i++) {
+      PString* entry = table->entries[i];
+      if (entry == NULL || entry == STRING_TOMBSTONE)
+        continue;
+      string_table_insert(entries, capacity, entry);
+    }
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    table->tombstones = 0;
+  }
+
+  if (!string_table_insert(table->entries, table->capacity, string))
+    table->tombstones--;
+  table->count++;
+}
+
+/**
+ * @brief Removes every string the garbage collector did not mark, so a
+ * collection that frees them over several steps never hands them out again.
+ *
+ * @param table StringTable* the table to remove from.
+ */
+void string_table_remove_unmarked(StringTable* table) {
+  for (int i = 0; i < table->capacity; i++) {
+    PString* string = table->entries[i];
+    if (string == NULL || string == STRING_TOMBSTONE ||
+        gc_is_marked((PObject*)string))
+      continue;
+    table->entries[i] = STRING_TOMBSTONE;
+    table->count--;
+    table->tombstones++;
+  }
+}
@@ -16,30 +16,63 @@
 
 #define HASH_STRING(str) hashString(str, strlen(str))
 
+typedef struct PString PString;
+
+// keys are interned strings, so they are compared by pointer. The key's hash
+// is kept alongside it so probing and rehashing never touch the string.
+// Tables use Robin Hood hashing with backward shift deletes, or plain linear
+// probing with tombstones when built with POSITRON_HASH_LINEAR.
 typedef struct Entry {
-  char* key;
-  Value* value;
+  PString* key;
+  uint32_t hash;
+  Value value;
 } Entry;
 
 typedef struct HashTable {
+  // live entries
   int count;
+  // deleted entries still occupying a slot, only used by linear probing
+  int tombstones;
   int capacity;
   Entry* entries;
 } HashTable;
 
+#ifdef POSITRON_PROFILE
+// probe counts of every table lookup, insert and delete
+typedef struct HashTableStats {
+  uint64_t lookups;
+  uint64_t probes;
+  int longest_probe;
+} HashTableStats;
+
+extern HashTableStats hash_table_stats;
+#endif
+
+// a set of interned strings, probed by the hash cached in each string
+typedef struct StringTable {
+  int count;
+  int tombstones;
+  int capacity;
+  PString** entries;
+} StringTable;
+
 void hash_table_init(HashTable* table);
-Value* hash_table_get(HashTable* table, const char* key);
-Value* hash_table_get_n(HashTable* table, const char* key_start, size_t length);
-bool hash_table_set(HashTable* table, const char* key, Value* value);
-bool hash_table_delete(HashTable* table, const char* key);
+Value* hash_table_get(HashTable* table, PString* key);
+bool hash_table_set(HashTable* table, PString* key, Value value);
+bool hash_table_delete(HashTable* table, PString* key);
 void hash_table_add_all(HashTable* from, HashTable* to);
-char* hash_table_find_string(HashTable* table,
-                             const char* chars,
-                             size_t length,
-                             uint32_t hash);
 void hash_table_print(HashTable* table);
 void hash_table_free(HashTable* table);
 
+void string_table_init(StringTable* table);
+PString* string_table_find(StringTable* table,
+                           const char* chars,
+                           size_t length,
+                           uint32_t hash);
+void string_table_add(StringTable* table, PString* string);
+void string_table_remove_unmarked(StringTable* table);
+void string_table_free(StringTable* table);
+
 static inline uint32_t hashString(const char* key, size_t length) {
   uint32_t hash = 2166136261u;
   for (size_t i = 0; i < length; i++) {
@@ -1,4 +1,3 @@
-
 /**
  * @file interpreter.c
  * @author Devin Arena
@@ -6,12 +5,17 @@
  * @since 1/7/2023
  **/
 
+#include <assert.h>
 #include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "gc.h"
 #include "interpreter.h"
+#include "pool.h"
 #include "positron.h"
 #include "standard_lib.h"
 
@@ -26,10 +30,110 @@ CallFrame* frame;
 void interpreter_init() {
   interpreter.fp = 0;
   interpreter.sp = 0;
-  interpreter.heap = NULL;
-  hash_table_init(&interpreter.globals);
-  hash_table_init(&interpreter.strings);
-  init_standard_lib(&interpreter.globals);
+  interpreter.stack = malloc(sizeof(Value) * STACK_SIZE);
+  interpreter.stack_capacity = STACK_SIZE;
+  interpreter.frames = malloc(sizeof(CallFrame) * FRAMES_SIZE);
+  interpreter.frame_capacity = FRAMES_SIZE;
+  if (!interpreter.stack || !interpreter.frames) {
+    printf("Failed to allocate memory for the interpreter stacks.\n");
+    exit(1);
+  }
+#ifdef POSITRON_PROFILE
+  interpreter.instructions = 0;
+#endif
+  interpreter.globals = NULL;
+  interpreter.global_count = 0;
+  gc_init();
+  string_table_init(&interpreter.strings);
+  hash_table_init(&interpreter.list_methods);
+  init_list_methods(&interpreter.list_methods);
+}
+
+/**
+ * @brief Allocates the interpreter's global array with one slot for every
+ * global the parser resolved, initialized to null.
+ *
+ * @param count the number of global slots
+ */
+void interpreter_define_globals(size_t count) {
+  interpreter.globals =
+      realloc(interpreter.globals, sizeof(Value) * (count ? count : 1));
+  if (!interpreter.globals) {
+    printf("Failed to allocate memory for the interpreter globals.\n");
+    exit(1);
+  }
+  for (size_t i = interpreter.global_count; i < count; i++)
+    interpreter.globals[i] = value_new_null();
+  interpreter.global_count = count;
+}
+
+/**
+ * @brief Prints the location of the instruction currently being executed as
+ * the start of a runtime error message. Expects frame->ip to point just past
+ * the failing instruction's opcode.
+ */
+static void runtime_error_location() {
+  Block* block = frame->function->block;
+  size_t instruction = frame->ip > 0 ? frame->ip - 1 : 0;
+  printf("[line %d] Runtime error: ", block->lines[instruction]);
+}
+
+/**
+ * @brief Reports a runtime error at the current instruction and exits.
+ *
+ * @param format the printf style error message
+ */
+static void runtime_error(const char* format, ...) {
+  runtime_error_location();
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  printf("\n");
+  exit(1);
+}
+
+/**
+ * @brief Grows the value stack so it can hold at least needed values, up to
+ * STACK_MAX. The stack moves when it grows, so the slots of every frame are
+ * rebased onto the new allocation.
+ *
+ * @param needed the number of values the stack must be able to hold
+ */
+static void grow_stack(size_t needed) {
+  if (needed > STACK_MAX)
+    runtime_error("stack overflow");
+
+  size_t capacity = interpreter.stack_capacity * GROWTH_FACTOR;
+  while (capacity < needed)
+    capacity *= GROWTH_FACTOR;
+  if (capacity > STACK_MAX)
+    capacity = STACK_MAX;
+
+  Value* stack = malloc(sizeof(Value) * capacity);
+  if (!stack) {
+    printf("Failed to allocate memory for the stack.\n");
+    exit(1);
+  }
+  memcpy(stack, interpreter.stack, sizeof(Value) * interpreter.sp);
+  for (int i = 0; i < interpreter.fp; i++) {
+    CallFrame* f = &interpreter.frames[i];
+    f->slots = stack + (f->slots - interpreter.stack);
+  }
+  free(interpreter.stack);
+  interpreter.stack = stack;
+  interpreter.stack_capacity = capacity;
+}
+
+/**
+ * @brief Makes sure the value stack can hold at least needed values. Kept
+ * apart from grow_stack() so the check inlines into calls.
+ *
+ * @param needed the number of values the stack must be able to hold
+ */
+static inline void reserve_stack(size_t needed) {
+  if (needed > interpreter.stack_capacity)
+    grow_stack(needed);
 }
 
 /**
@@ -38,10 +142,8 @@ void interpreter_init() {
  * @return Value the value popped from the stack
  */
 static Value pop_stack() {
-  if (interpreter.sp <= 0) {
-    printf("pop from empty stack");
-    exit(1);
-  }
+  if (interpreter.sp <= 0)
+    runtime_error("pop from empty stack");
   Value value = interpreter.stack[--interpreter.sp];
   return value;
 }
@@ -52,362 +154,557 @@ static Value pop_stack() {
  * @param value the value to push onto the stack
  */
 static void push_stack(Value value) {
-  if (interpreter.sp == STACK_SIZE) {
-    printf("stack overflow");
-    exit(1);
-  }
+  reserve_stack(interpreter.sp + 1);
   interpreter.stack[interpreter.sp++] = value;
 }
 
 /**
- * @brief Peeks at a local variable at a specific stack depth.
- *
- * @param depth the depth to peek at
- * @return Value the value at the depth
+ * @brief Grows the frame stack, up to FRAMES_MAX. Frames may move when it
+ * grows, so callers must refetch the current frame.
  */
-static Value peek_stack(int depth) {
-  if (interpreter.sp < depth + 1) {
-    printf("peek depth exceeds stack size");
+static void grow_frames() {
+  if (interpreter.frame_capacity >= FRAMES_MAX)
+    runtime_error("frame stack overflow");
+  size_t capacity = interpreter.frame_capacity * GROWTH_FACTOR;
+  if (capacity > FRAMES_MAX)
+    capacity = FRAMES_MAX;
+  interpreter.frames =
+      realloc(interpreter.frames, sizeof(CallFrame) * capacity);
+  if (!interpreter.frames) {
+    printf("Failed to allocate memory for the frame stack.\n");
     exit(1);
   }
-  return interpreter.stack[interpreter.sp - depth - 1];
+  interpreter.frame_capacity = capacity;
 }
 
-static void push_frame(CallFrame frame) {
-  if (interpreter.fp == MAX_FRAMES) {
-    printf("frame stack overflow");
-    exit(1);
-  }
+/**
+ * @brief Pushes a call frame, growing the frame stack when it is full.
+ *
+ * @param frame the frame to push
+ */
+static inline void push_frame(CallFrame frame) {
+  if ((size_t)interpreter.fp == interpreter.frame_capacity)
+    grow_frames();
   interpreter.frames[interpreter.fp++] = frame;
 }
 
 static void pop_frame() {
-  if (interpreter.fp < 0) {
-    printf("pop from empty frame stack");
-    exit(1);
-  }
+  if (interpreter.fp < 0)
+    runtime_error("pop from empty frame stack");
   interpreter.fp--;
 }
 
+/**
+ * @brief Runs a builtin on the arguments at the top of the stack and replaces
+ * them and the callable or receiver below them with its result.
+ *
+ * @param builtin the builtin to run
+ * @param receiver the object the builtin is called on, NULL for functions
+ * @param arg_count the number of arguments on the stack
+ */
+static void call_builtin(PBuiltin* builtin, PObject* receiver,
+                         size_t arg_count) {
+  if (arg_count != builtin->arity) {
+    runtime_error("Expected %zu arguments but got %zu.", builtin->arity,
+                  arg_count);
+  }
+  Value result = builtin->function(
+      receiver, arg_count, &interpreter.stack[interpreter.sp - arg_count]);
+  interpreter.sp -= arg_count + 1;
+  push_stack(result);
+}
+
+/**
+ * @brief Calls a callable object sitting below its arguments on the stack.
+ * Functions get a new call frame, builtins and struct templates run to
+ * completion and replace the callable and arguments with their result.
+ *
+ * @param obj the object to call
+ * @param arg_count the number of arguments above the object on the stack
+ */
 static void call_object(Value obj, size_t arg_count) {
-  PObject* object = (PObject*)obj.data.reference;
+  PObject* object = value_as_object(obj);
   switch (object->type) {
     case P_OBJ_FUNCTION: {
       if (arg_count != ((PFunction*)object)->arity) {
-        printf("Expected %lld arguments but got %lld.",
-               ((PFunction*)object)->arity, arg_count);
-        exit(1);
+        runtime_error("Expected %zu arguments but got %zu.",
+                      ((PFunction*)object)->arity, arg_count);
       }
-      frame->ip += 2;
+      reserve_stack(interpreter.sp - arg_count +
+                    ((PFunction*)object)->max_stack);
       push_frame((CallFrame){.ip = 0, .function = (PFunction*)object});
       frame = &interpreter.frames[interpreter.fp - 1];
       frame->slots = &interpreter.stack[interpreter.sp - arg_count];
       frame->slotCount = arg_count;
       break;
     }
-    case P_OBJ_BUILTIN: {
-      frame->ip += 2;
-      PBuiltin* builtin = (PBuiltin*)object;
-      if (arg_count != builtin->arity) {
-        printf("Expected %lld arguments but got %lld.", builtin->arity,
-               arg_count);
-        exit(1);
-      }
-      Value result =
-          builtin->function(builtin->parent, arg_count,
-                            &interpreter.stack[interpreter.sp - arg_count]);
-      for (size_t i = 0; i < arg_count; i++) {
-        pop_stack();
-      }
-      pop_stack();
-      push_stack(result);
+    case P_OBJ_BUILTIN:
+      call_builtin((PBuiltin*)object, NULL, arg_count);
+      break;
+    case P_OBJ_BOUND_METHOD: {
+      PBoundMethod* bound = (PBoundMethod*)object;
+      call_builtin(bound->method, bound->receiver, arg_count);
       break;
     }
     case P_OBJ_STRUCT_TEMPLATE: {
-      frame->ip += 2;
       PStructTemplate* struct_template = (PStructTemplate*)object;
       if ((int)arg_count != struct_template->fields.count) {
-        printf("Expected %d arguments but got %lld.",
-               struct_template->fields.count, arg_count);
-        exit(1);
+        runtime_error("Expected %d arguments but got %zu.",
+                      struct_template->fields.count, arg_count);
       }
       PStructInstance* struct_instance =
           p_object_struct_instance_new(struct_template);
-      // loop over the hash table in the template and create an array of values
-      char** fields = malloc(sizeof(char*) * struct_template->fields.count);
-      for (int i = 0; i < struct_template->fields.capacity; i++) {
-        if (struct_template->fields.entries[i].key == NULL ||
-            struct_template->fields.entries[i].value == NULL ||
-            struct_template->fields.entries[i].value->type != VAL_NUMBER)
-          continue;
-        int index =
-            (int)(struct_template->fields.entries[i].value->data.number);
-        char* field = malloc(sizeof(char) *
-                             strlen(struct_template->fields.entries[i].key));
-        strcpy(field, struct_template->fields.entries[i].key);
-        fields[index] = field;
-      }
-      // loop over the arguments and assign them to the struct instance
-      for (int i = struct_template->fields.count - 1; i >= 0; i--) {
-        Value value = pop_stack();
-        hash_table_set(&struct_instance->fields, fields[i], &value);
-      }
-      pop_stack();  // pop the struct template
+      // the arguments are in declaration order, the same as the field slots
+      memcpy(struct_instance->fields,
+             &interpreter.stack[interpreter.sp - arg_count],
+             sizeof(Value) * arg_count);
+      // large instances are allocated old and need the barrier
+      if (!gc_is_young((PObject*)struct_instance))
+        gc_remember((PObject*)struct_instance);
+      interpreter.sp -= arg_count + 1;
       push_stack(value_new_object((PObject*)struct_instance));
-      free(fields);
       break;
     }
     default: {
-      printf("Expected callable object type.");
-      exit(1);
+      runtime_error("Expected callable object type.");
     }
   }
 }
 
 /**
  * OPCODE FUNCTIONS
+ *
+ * Slower opcodes are implemented as functions that work on the interpreter's
+ * stack directly. The interpreter loop writes its cached stack top back before
+ * calling them and reloads it afterwards.
  */
-static int negate() {
-  Value a = pop_stack();
-  switch (a.type) {
-    case VAL_NUMBER:
-      push_stack(value_new_number(-a.data.number));
-      break;
-    default:
-      printf("Expected numeric value to negate.");
-      exit(1);
-  }
-  return 1;
-}
 
 /**
- * @brief Executes a binary operation on the top two values on the stack.
+ * @brief Finds the slot of a struct instance field through the instance's
+ * template, and fills the instruction's inline cache with it so the next
+ * access to an instance of the same template can skip the lookup.
  *
- * @param op the operation to execute
- * @return int the number of bytes to advance the instruction pointer
+ * @param instance the struct instance
+ * @param cache the inline cache of the instruction accessing the field
+ * @return Value* the field's slot, or NULL if the template has no such field.
  */
-static int binary(enum TokenType op) {
-  Value b = pop_stack();
-  Value a = pop_stack();
-  switch (op) {
-    case TOKEN_PLUS: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_number(a.data.number + b.data.number));
-      } else {
-        printf("Undefined operation for given values.");
-        exit(1);
-      }
-      break;
-    }
-    case TOKEN_MINUS: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_number(a.data.number - b.data.number));
-      } else {
-        printf("Undefined operation for given values.");
-        exit(1);
-      }
-      break;
-    }
-    case TOKEN_STAR: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_number(a.data.number * b.data.number));
-      } else {
-        printf("Undefined operation for given values.");
-        exit(1);
-      }
-      break;
-    }
-    case TOKEN_SLASH: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        if (b.data.number == 0) {
-          printf("Division by zero.");
-          exit(1);
-        }
-        push_stack(value_new_number(a.data.number / b.data.number));
-      } else {
-        printf("Undefined operation for given values.");
-        exit(1);
-      }
-      break;
-    }
-    case TOKEN_LESS: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_boolean(a.data.number < b.data.number));
-      } else {
-        printf("Undefined operation for given values.");
-        exit(1);
-      }
-      break;
-    }
-    case TOKEN_LESS_EQUAL: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_boolean(a.data.number <= b.data.number));
-      } else {
-        printf("Undefined operation for given values.");
-        exit(1);
-      }
-      break;
-    }
-    case TOKEN_GREATER: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_boolean(a.data.number > b.data.number));
-      } else {
-        printf("Undefined operation for given values.");
-        exit(1);
-      }
-      break;
-    }
-    case TOKEN_GREATER_EQUAL: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_boolean(a.data.number >= b.data.number));
-      } else {
-        printf("Undefined operation for given values.");
-        exit(1);
-      }
-      break;
-    }
-    case TOKEN_EQUAL_EQUAL: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_boolean(a.data.number == b.data.number));
-      } else {
-        push_stack(value_new_boolean(false));
-      }
-      break;
-    }
-    case TOKEN_NOT_EQUAL: {
-      if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) {
-        push_stack(value_new_boolean(a.data.number != b.data.number));
-      } else {
-        push_stack(value_new_boolean(true));
-      }
-      break;
-    }
-    default: {
-      printf("Undefined binary operator.");
-      exit(1);
-    }
-  }
-  return 1;
+static Value* struct_field(PStructInstance* instance, InlineCache* cache) {
+  Value* slot = hash_table_get(&instance->template->fields, cache->name);
+  if (slot == NULL)
+    return NULL;
+  // the cache keeps the template alive once the instance is gone
+  gc_shade((PObject*)instance->template);
+  cache->shape = (PObject*)instance->template;
+  cache->slot = value_as_integer(*slot);
+  return &instance->fields[cache->slot];
 }
 
 /**
- * @brief Gets a field of a struct instance and pushes it to the stack.
+ * @brief Gets a field for an instruction whose inline cache missed and pushes
+ * it to the stack.
  *
- * @return int 1 the number of bytes to move the instruction pointer by
+ * @param cache the inline cache of the instruction
  */
-static int field_get() {
-  Value field = pop_stack();
+static void field_get(InlineCache* cache) {
   Value object = pop_stack();
-  if (object.type != VAL_OBJ) {
-    printf("Expected object type.");
-    exit(1);
-  }
-  if (!IS_TYPE(field, P_OBJ_STRING)) {
-    printf("Expected string type.");
-    exit(1);
-  }
-  char* ftext = TO_STRING(field)->value;
-  switch (object.data.reference->type) {
+  if (!value_is_object(object))
+    runtime_error("Expected object type.");
+  switch (value_as_object(object)->type) {
     case P_OBJ_STRUCT_INSTANCE: {
-      Value* value = hash_table_get(&TO_STRUCT_INSTANCE(object)->fields, ftext);
-      if (value == NULL) {
-        printf("Undefined field '%s'.", ftext);
-        exit(1);
-      }
-      push_stack(*value);
+      Value* field = struct_field(TO_STRUCT_INSTANCE(object), cache);
+      if (field == NULL)
+        runtime_error("Undefined field '%s'.", cache->name->value);
+      push_stack(*field);
       break;
     }
     case P_OBJ_LIST: {
-      // TODO: there might be a better way to do this
-      PList* list = TO_LIST(object);
-      Value* method = hash_table_get(&list->methods, ftext);
-      if (method == NULL) {
-        printf("Undefined method '%s'.", ftext);
-        exit(1);
-      }
-      push_stack(*method);
+      Value* method = hash_table_get(&interpreter.list_methods, cache->name);
+      if (method == NULL)
+        runtime_error("Undefined method '%s'.", cache->name->value);
+      // the list stays on the stack while the bound method is allocated,
+      // which may move it, so it is read back from the stack afterwards
+      push_stack(object);
+      PBoundMethod* bound =
+          p_object_bound_method_new(NULL, (PBuiltin*)value_as_object(*method));
+      object = interpreter.stack[interpreter.sp - 1];
+      bound->receiver = value_as_object(object);
+      gc_write_barrier((PObject*)bound, object);
+      interpreter.stack[interpreter.sp - 1] = value_new_object((PObject*)bound);
       break;
     }
     default:
-      printf("Expected struct instance type.");
-      exit(1);
+      runtime_error("Expected struct instance type.");
   }
-  return 1;
 }
 
 /**
- * @brief Sets a field of a struct instance to a value.
+ * @brief Sets a field for an instruction whose inline cache missed. Struct
+ * layouts are fixed, so fields cannot be added.
  *
- * @return int 1 the number of bytes to move the instruction pointer by
+ * @param cache the inline cache of the instruction
  */
-static int field_set() {
-  Value field = pop_stack();
+static void field_set(InlineCache* cache) {
   Value value = pop_stack();
   Value object = pop_stack();
-  if (object.type != VAL_OBJ ||
-      object.data.reference->type != P_OBJ_STRUCT_INSTANCE) {
-    printf("Expected object type.");
-    exit(1);
-  }
-  if (field.type != VAL_OBJ || field.data.reference->type != P_OBJ_STRING) {
-    printf("Expected string type.");
-    exit(1);
-  }
-  char* ftext = TO_STRING(field)->value;
-  hash_table_set(&TO_STRUCT_INSTANCE(object)->fields, ftext, &value);
-  return 1;
+  if (!IS_TYPE(object, P_OBJ_STRUCT_INSTANCE))
+    runtime_error("Expected struct instance type.");
+  Value* field = struct_field(TO_STRUCT_INSTANCE(object), cache);
+  if (field == NULL)
+    runtime_error("Undefined field '%s'.", cache->name->value);
+  *field = value;
+  gc_write_barrier(value_as_object(object), value);
 }
 
 /**
- * @brief Creates a new list and pushes it to the stack.
+ * @brief Calls a method on the receiver sitting below the arguments on the
+ * stack. List methods run directly on the receiver, without binding them
+ * first. A struct field is read through the instruction's inline cache and
+ * called in place of the receiver.
  *
- * @return int 1 the number of bytes to move the instruction pointer by
+ * @param cache the inline cache of the instruction
+ * @param arg_count the number of arguments above the receiver
  */
-static int list() {
-  Value count = pop_stack();
-  PList* list = p_object_list_new();
-  Value* values = malloc(sizeof(Value) * count.data.number);
-  for (int i = count.data.number - 1; i >= 0; i--) {
-    Value value = pop_stack();
-    values[i] = value;
-  }
-  for (int i = 0; i < count.data.number; i++) {
-    dyn_list_add(list->list, value_clone(values + i));
+static void invoke(InlineCache* cache, size_t arg_count) {
+  Value* receiver = &interpreter.stack[interpreter.sp - arg_count - 1];
+  if (!value_is_object(*receiver))
+    runtime_error("Expected object type.");
+  switch (value_as_object(*receiver)->type) {
+    case P_OBJ_STRUCT_INSTANCE: {
+      PStructInstance* instance = TO_STRUCT_INSTANCE(*receiver);
+      Value* field = (PObject*)instance->template == cache->shape
+                         ? &instance->fields[cache->slot]
+                         : struct_field(instance, cache);
+      if (field == NULL)
+        runtime_error("Undefined field '%s'.", cache->name->value);
+      if (!value_is_object(*field))
+        runtime_error("Expected callable object type.");
+      *receiver = *field;
+      call_object(*receiver, arg_count);
+      break;
+    }
+    case P_OBJ_LIST: {
+      Value* method = hash_table_get(&interpreter.list_methods, cache->name);
+      if (method == NULL)
+        runtime_error("Undefined method '%s'.", cache->name->value);
+      call_builtin((PBuiltin*)value_as_object(*method),
+                   value_as_object(*receiver), arg_count);
+      break;
+    }
+    default:
+      runtime_error("Expected struct instance type.");
   }
-  free(values);
+}
+
+/**
+ * @brief Creates a new list and pushes it to the stack.
+ */
+static void list() {
+  size_t count = value_as_integer(pop_stack());
+  PList* list = p_object_list_new(count);
+  interpreter.sp -= count;
+  // the elements are on the stack in order
+  for (size_t i = 0; i < count; i++)
+    list->values[i] = interpreter.stack[interpreter.sp + i];
+  list->count = count;
   push_stack(value_new_object((PObject*)list));
-  return 1;
 }
 
 /**
  * @brief Gets an element of a list and pushes it to the stack.
- *
- * @return int 1 the number of bytes to move the instruction pointer by
  */
-static int list_index() {
+static void list_index() {
   Value index = pop_stack();
   Value list = pop_stack();
-  if (list.type != VAL_OBJ || list.data.reference->type != P_OBJ_LIST) {
+  if (!IS_TYPE(list, P_OBJ_LIST)) {
+    runtime_error_location();
     printf("Cannot access elements of ");
     value_print(&list);
-    printf(".");
+    printf(".\n");
     exit(1);
   }
-  if (index.type != VAL_NUMBER) {
+  if (!value_is_numeric(index)) {
+    runtime_error_location();
     printf("Cannot access element with index ");
     value_print(&index);
-    printf(".");
+    printf(".\n");
     exit(1);
   }
 
-  if (index.data.number < 0 || index.data.number >= TO_LIST(list)->list->size) {
-    printf("Index out of bounds.");
-    exit(1);
+  // integer indices are used as is, numbers are truncated
+  int64_t i = value_is_integer(index) ? value_as_integer(index)
+                                      : (int64_t)value_as_number(index);
+  if (i < 0 || i >= (int64_t)TO_LIST(list)->count)
+    runtime_error("Index out of bounds.");
+
+  push_stack(TO_LIST(list)->values[i]);
+}
+
+/**
+ * The interpreter loop keeps the hot parts of the current frame in locals so
+ * the compiler can hold them in registers: the instruction pointer, the code
+ * and constant arrays of the running function, its slots and the stack top.
+ * They are written back to the CallFrame and interpreter only when calling,
+ * returning, running a slow opcode function, or reporting an error.
+ *
+ * Pushes are not bounds checked at runtime. Each function records the deepest
+ * its stack gets, and the stack is grown to fit that once when it is called.
+ * Builds without NDEBUG assert that pushes stay within that reserve and pops
+ * above the bottom of the stack, so a miscounted max_stack fails loudly.
+ */
+
+#define READ_BYTE() (*ip++)
+#define READ_U16() (ip += 2, (uint16_t)(ip[-2] << 8 | ip[-1]))
+#define READ_U24() \
+  (ip += 3, (size_t)ip[-3] << 16 | (size_t)ip[-2] << 8 | (size_t)ip[-1])
+
+#define PUSH(value)                                                    \
+  (assert(sp < frame->slots + frame->function->max_stack), *sp++ = (value))
+#define POP() (assert(sp > interpreter.stack), *--sp)
+#define PEEK(depth) \
+  (assert(sp - 1 - (depth) >= interpreter.stack), sp[-1 - (depth)])
+
+// writes the cached registers back to the frame and interpreter
+#define SAVE_FRAME()      \
+  (frame->ip = ip - code, \
+   interpreter.sp = (int)(sp - interpreter.stack))
+
+// reloads the cached registers from the current frame and interpreter
+#define LOAD_FRAME()                               \
+  do {                                             \
+    code = frame->function->block->code;           \
+    ip = code + frame->ip;                         \
+    constants = frame->function->block->constants; \
+    caches = frame->function->block->caches;       \
+    slots = frame->slots;                          \
+    sp = interpreter.stack + interpreter.sp;       \
+  } while (0)
+
+// runs a slow opcode function against the interpreter's stack
+#define CALL_SLOW(fn, ...) \
+  do {                     \
+    SAVE_FRAME();          \
+    fn(__VA_ARGS__);       \
+    LOAD_FRAME();          \
+  } while (0)
+
+#ifdef POSITRON_DEBUG
+#define VM_TRACE() \
+  (DEBUG_MODE ? (SAVE_FRAME(), interpreter_print()) : (void)0)
+#else
+#define VM_TRACE() ((void)0)
+#endif
+
+#ifdef POSITRON_PROFILE
+#define VM_COUNT() (interpreter.instructions++)
+#else
+#define VM_COUNT() ((void)0)
+#endif
+
+#define VM_FETCH() (VM_COUNT(), VM_TRACE(), READ_BYTE())
+
+/**
+ * Dispatch for the interpreter loop. With computed gotos every handler jumps
+ * directly to the next one through a table of label addresses, otherwise the
+ * handlers are cases of a switch that is re-entered after each instruction.
+ */
+#ifdef POSITRON_COMPUTED_GOTO
+#define VM_LOOP VM_DISPATCH();
+#define VM_CASE(op) label_##op
+#define VM_DISPATCH() goto* dispatch_table[VM_FETCH()]
+#else
+#define VM_LOOP \
+  for (;;)      \
+    switch (VM_FETCH())
+#define VM_CASE(op) case op
+#define VM_DISPATCH() continue
+#endif
+
+/**
+ * Integer arithmetic helpers. Each stores the result and returns true, or
+ * returns false if the result is outside the range of integer values so the
+ * caller can fall back to doubles.
+ */
+
+static inline bool integer_add(int64_t a, int64_t b, int64_t* result) {
+  if ((b > 0 && a > VALUE_INTEGER_MAX - b) ||
+      (b < 0 && a < VALUE_INTEGER_MIN - b))
+    return false;
+  *result = a + b;
+  return true;
+}
+
+static inline bool integer_sub(int64_t a, int64_t b, int64_t* result) {
+  if ((b < 0 && a > VALUE_INTEGER_MAX + b) ||
+      (b > 0 && a < VALUE_INTEGER_MIN + b))
+    return false;
+  *result = a - b;
+  return true;
+}
+
+static inline bool integer_mul(int64_t a, int64_t b, int64_t* result) {
+  if (a > 0 ? (b > 0 ? a > VALUE_INTEGER_MAX / b : b < VALUE_INTEGER_MIN / a)
+            : (b > 0 ? a < VALUE_INTEGER_MIN / b
+                     : a != 0 && b < VALUE_INTEGER_MAX / a))
+    return false;
+  *result = a * b;
+  return true;
+}
+
+/**
+ * @brief Pops two numeric values and pushes the result of an arithmetic
+ * operation. Two integers use integer_op and stay integers unless the result
+ * overflows, anything else is computed with doubles.
+ */
+#define BINARY_ARITH_OP(integer_op, op)                                  \
+  do {                                                                   \
+    Value b = POP();                                                     \
+    Value a = POP();                                                     \
+    int64_t result;                                                      \
+    if (value_is_integer(a) && value_is_integer(b) &&                    \
+        integer_op(value_as_integer(a), value_as_integer(b), &result)) { \
+      *sp++ = value_new_integer(result);                                 \
+      break;                                                             \
+    }                                                                    \
+    if (!value_is_numeric(a) || !value_is_numeric(b)) {                  \
+      SAVE_FRAME();                                                      \
+      runtime_error("Undefined operation for given values.");            \
+    }                                                                    \
+    *sp++ = value_new_number(value_to_number(a) op value_to_number(b));  \
+  } while (0)
+
+/**
+ * @brief Pops two numeric values and pushes the boolean result of comparing
+ * them, comparing integers directly and anything else as doubles.
+ */
+#define BINARY_COMPARE_OP(op)                                                \
+  do {                                                                       \
+    Value b = POP();                                                         \
+    Value a = POP();                                                         \
+    if (value_is_integer(a) && value_is_integer(b)) {                        \
+      *sp++ = value_new_boolean(value_as_integer(a) op value_as_integer(b)); \
+      break;                                                                 \
+    }                                                                        \
+    if (!value_is_numeric(a) || !value_is_numeric(b)) {                      \
+      SAVE_FRAME();                                                          \
+      runtime_error("Undefined operation for given values.");                \
+    }                                                                        \
+    *sp++ = value_new_boolean(value_to_number(a) op value_to_number(b));     \
+  } while (0)
+
+/**
+ * Quickening. The generic arithmetic and comparison opcodes look at their
+ * operands and rewrite themselves in place into a form specialized for two
+ * integers or two numbers. The specialized forms only check that their
+ * operands still have the expected types, and if not (or if integer math would
+ * overflow) they rewrite themselves back to the generic opcode and re-dispatch
+ * to it with the operands left untouched on the stack.
+ *
+ * The specialized handlers are plain blocks rather than do-while loops since
+ * re-dispatching in switch mode continues the dispatch loop.
+ */
+
+// rewrites the opcode currently executing
+#define QUICKEN(opcode) (ip[-1] = (opcode))
+
+// rewrites the opcode currently executing and runs the new opcode instead
+#define DEQUICKEN(opcode) \
+  {                       \
+    QUICKEN(opcode);      \
+    ip--;                 \
+    VM_DISPATCH();        \
   }
 
-  push_stack(*((Value*)TO_LIST(list)->list->data[(int)index.data.number]));
+// specializes a generic binary opcode based on its operands
+#define QUICKEN_BINARY(int_opcode, num_opcode)                   \
+  do {                                                           \
+    if (value_is_integer(sp[-1]) && value_is_integer(sp[-2]))    \
+      QUICKEN(int_opcode);                                       \
+    else if (value_is_number(sp[-1]) && value_is_number(sp[-2])) \
+      QUICKEN(num_opcode);                                       \
+  } while (0)
+
+#define INTEGER_ARITH_OP(integer_op, generic)                           \
+  {                                                                     \
+    int64_t result;                                                     \
+    if (!value_is_integer(sp[-1]) || !value_is_integer(sp[-2]) ||       \
+        !integer_op(value_as_integer(sp[-2]), value_as_integer(sp[-1]), \
+                    &result))                                           \
+      DEQUICKEN(generic);                                               \
+    sp--;                                                               \
+    sp[-1] = value_new_integer(result);                                 \
+  }
+
+#define INTEGER_COMPARE_OP(op, generic)                         \
+  {                                                             \
+    if (!value_is_integer(sp[-1]) || !value_is_integer(sp[-2])) \
+      DEQUICKEN(generic);                                       \
+    sp--;                                                       \
+    sp[-1] = value_new_boolean(value_as_integer(sp[-1])         \
+                                   op value_as_integer(sp[0])); \
+  }
+
+#define NUMBER_BINARY_OP(value_new, op, generic)                           \
+  {                                                                        \
+    if (!value_is_number(sp[-1]) || !value_is_number(sp[-2]))              \
+      DEQUICKEN(generic);                                                  \
+    sp--;                                                                  \
+    sp[-1] = value_new(value_as_number(sp[-1]) op value_as_number(sp[0])); \
+  }
 
-  return 1;
+// whether value is a struct instance with the template cached by cache
+#define CACHE_HIT(value, cache)                  \
+  (IS_TYPE(value, P_OBJ_STRUCT_INSTANCE) &&      \
+   (PObject*)TO_STRUCT_INSTANCE(value)->template == (cache)->shape)
+
+// reads a field of the struct instance on top of the stack in place when the
+// instruction's inline cache hits, otherwise looks it up with field_get()
+#define FIELD_GET(cache)                                              \
+  {                                                                   \
+    InlineCache* field_cache = (cache);                               \
+    if (CACHE_HIT(sp[-1], field_cache))                               \
+      sp[-1] = TO_STRUCT_INSTANCE(sp[-1])->fields[field_cache->slot]; \
+    else                                                              \
+      CALL_SLOW(field_get, field_cache);                              \
+  }
+
+// stores the value on top of the stack in a field of the struct instance
+// below it when the instruction's inline cache hits, otherwise looks the
+// field up with field_set()
+#define FIELD_SET(cache)                                              \
+  {                                                                   \
+    InlineCache* field_cache = (cache);                               \
+    if (CACHE_HIT(sp[-2], field_cache)) {                             \
+      TO_STRUCT_INSTANCE(sp[-2])->fields[field_cache->slot] = sp[-1]; \
+      gc_write_barrier(value_as_object(sp[-2]), sp[-1]);              \
+      sp -= 2;                                                        \
+    } else {                                                          \
+      CALL_SLOW(field_set, field_cache);                              \
+    }                                                                 \
+  }
+
+/**
+ * @brief Checks whether a condition is truthy. Comparisons produce booleans,
+ * so those are tested inline and only other values go through
+ * value_is_truthy().
+ */
+static inline bool condition_is_true(Value condition) {
+  if (value_is_boolean(condition))
+    return value_as_boolean(condition);
+  return value_is_truthy(&condition);
+}
+
+/**
+ * @brief Checks whether two values are equal numbers or the same object.
+ * Strings are interned, so equal strings are always the same object. Other
+ * values are never equal.
+ */
+static inline bool values_equal(Value a, Value b) {
+  if (value_is_integer(a) && value_is_integer(b))
+    return value_as_integer(a) == value_as_integer(b);
+  if (value_is_object(a) && value_is_object(b))
+    return value_as_object(a) == value_as_object(b);
+  return value_is_numeric(a) && value_is_numeric(b) &&
+         value_to_number(a) == value_to_number(b);
 }
 
 /**
@@ -417,265 +714,424 @@ static int list_index() {
  * @return InterpretResult the result of the interpretation
  */
 InterpretResult interpret(PFunction* function) {
-  interpreter_init();
-
+  // the parser stores into objects without write barriers, so collections
+  // only become incremental once the script runs
+  gc.incremental = GC_INCREMENTAL;
   push_frame(
       (CallFrame){.ip = 0, .function = function, .slotCount = function->arity});
   frame = &interpreter.frames[interpreter.fp - 1];
   frame->slots = interpreter.stack;
 
-  while (frame->ip < frame->function->block->opcodes->size) {
-#ifdef POSITRON_DEBUG
-    if (DEBUG_MODE)
-      interpreter_print();
+#ifdef POSITRON_COMPUTED_GOTO
+  static void* dispatch_table[] = {
+      [OP_NOP] = &&VM_CASE(OP_NOP),
+      [OP_POP] = &&VM_CASE(OP_POP),
+      [OP_DUPE] = &&VM_CASE(OP_DUPE),
+      [OP_SWAP] = &&VM_CASE(OP_SWAP),
+      [OP_EXIT] = &&VM_CASE(OP_EXIT),
+      [OP_RETURN] = &&VM_CASE(OP_RETURN),
+      [OP_PRINT] = &&VM_CASE(OP_PRINT),
+      [OP_LOCAL_SET] = &&VM_CASE(OP_LOCAL_SET),
+      [OP_LOCAL_GET] = &&VM_CASE(OP_LOCAL_GET),
+      [OP_NEGATE] = &&VM_CASE(OP_NEGATE),
+      [OP_ADD] = &&VM_CASE(OP_ADD),
+      [OP_SUB] = &&VM_CASE(OP_SUB),
+      [OP_MUL] = &&VM_CASE(OP_MUL),
+      [OP_DIV] = &&VM_CASE(OP_DIV),
+      [OP_NOT] = &&VM_CASE(OP_NOT),
+      [OP_LT] = &&VM_CASE(OP_LT),
+      [OP_GT] = &&VM_CASE(OP_GT),
+      [OP_LTE] = &&VM_CASE(OP_LTE),
+      [OP_GTE] = &&VM_CASE(OP_GTE),
+      [OP_EQ] = &&VM_CASE(OP_EQ),
+      [OP_NEQ] = &&VM_CASE(OP_NEQ),
+      [OP_LIST] = &&VM_CASE(OP_LIST),
+      [OP_INDEX] = &&VM_CASE(OP_INDEX),
+      [OP_CONSTANT] = &&VM_CASE(OP_CONSTANT),
+      [OP_CALL] = &&VM_CASE(OP_CALL),
+      [OP_FIELD_GET] = &&VM_CASE(OP_FIELD_GET),
+      [OP_FIELD_SET] = &&VM_CASE(OP_FIELD_SET),
+      [OP_GLOBAL_GET_SLOT] = &&VM_CASE(OP_GLOBAL_GET_SLOT),
+      [OP_GLOBAL_SET_SLOT] = &&VM_CASE(OP_GLOBAL_SET_SLOT),
+      [OP_JUMP] = &&VM_CASE(OP_JUMP),
+      [OP_JUMP_BACK] = &&VM_CASE(OP_JUMP_BACK),
+      [OP_CJUMPF] = &&VM_CASE(OP_CJUMPF),
+      [OP_CJUMPT] = &&VM_CASE(OP_CJUMPT),
+      [OP_INVOKE] = &&VM_CASE(OP_INVOKE),
+      [OP_CONSTANT_LONG] = &&VM_CASE(OP_CONSTANT_LONG),
+      [OP_LOCAL_GET_LONG] = &&VM_CASE(OP_LOCAL_GET_LONG),
+      [OP_LOCAL_SET_LONG] = &&VM_CASE(OP_LOCAL_SET_LONG),
+      [OP_GLOBAL_GET_SLOT_LONG] = &&VM_CASE(OP_GLOBAL_GET_SLOT_LONG),
+      [OP_GLOBAL_SET_SLOT_LONG] = &&VM_CASE(OP_GLOBAL_SET_SLOT_LONG),
+      [OP_FIELD_GET_LONG] = &&VM_CASE(OP_FIELD_GET_LONG),
+      [OP_FIELD_SET_LONG] = &&VM_CASE(OP_FIELD_SET_LONG),
+      [OP_INVOKE_LONG] = &&VM_CASE(OP_INVOKE_LONG),
+      [OP_ADD_INT] = &&VM_CASE(OP_ADD_INT),
+      [OP_ADD_NUM] = &&VM_CASE(OP_ADD_NUM),
+      [OP_SUB_INT] = &&VM_CASE(OP_SUB_INT),
+      [OP_SUB_NUM] = &&VM_CASE(OP_SUB_NUM),
+      [OP_MUL_INT] = &&VM_CASE(OP_MUL_INT),
+      [OP_MUL_NUM] = &&VM_CASE(OP_MUL_NUM),
+      [OP_LT_INT] = &&VM_CASE(OP_LT_INT),
+      [OP_LT_NUM] = &&VM_CASE(OP_LT_NUM),
+      [OP_GT_INT] = &&VM_CASE(OP_GT_INT),
+      [OP_GT_NUM] = &&VM_CASE(OP_GT_NUM),
+      [OP_LTE_INT] = &&VM_CASE(OP_LTE_INT),
+      [OP_LTE_NUM] = &&VM_CASE(OP_LTE_NUM),
+      [OP_GTE_INT] = &&VM_CASE(OP_GTE_INT),
+      [OP_GTE_NUM] = &&VM_CASE(OP_GTE_NUM),
+  };
 #endif
-    switch (*(uint8_t*)frame->function->block->opcodes->data[frame->ip]) {
-      case OP_NOP: {
-        frame->ip++;
-        break;
-      }
-      case OP_POP: {
-        pop_stack();
-        frame->ip++;
-        break;
-      }
-      case OP_DUPE: {
-        Value v = peek_stack(0);
-        push_stack(v);
-        frame->ip++;
-        break;
-      }
-      case OP_SWAP: {
-        Value a = pop_stack();
-        Value b = pop_stack();
-        push_stack(a);
-        push_stack(b);
-        frame->ip++;
-        break;
-      }
-      case OP_EXIT: {
-        Value res = pop_stack();
-        return (InterpretResult)res.data.number;
-      }
-      case OP_CALL: {
-        uint8_t arg_count =
-            *(uint8_t*)frame->function->block->opcodes->data[frame->ip + 1];
-        Value callable = peek_stack(arg_count);
-        if (callable.type != VAL_OBJ) {
-          printf("Expected callable object type.");
-          exit(1);
-        }
-        if (callable.data.reference->type != P_OBJ_FUNCTION &&
-            callable.data.reference->type != P_OBJ_BUILTIN &&
-            callable.data.reference->type != P_OBJ_STRUCT_TEMPLATE) {
-          printf("Expected callable object type.");
-          exit(1);
-        }
-        call_object(callable, arg_count);
-        break;
-      }
-      case OP_RETURN: {
-        Value res = value_new_null();
-        // TODO: look at this potentially
-        if (interpreter.stack + interpreter.sp - frame->slots -
-                frame->slotCount >
-            0) {
-          res = pop_stack();
-        }
-        pop_frame();
-        if (interpreter.fp <= 0) {
-          return INTERPRET_OK;
-        }
-        for (size_t i = 0; i < frame->slotCount + 1; i++) {
-          pop_stack();
-        }
-        frame = &interpreter.frames[interpreter.fp - 1];
-        push_stack(res);
-        break;
-      }
-      case OP_PRINT: {
-        Value v = pop_stack();
-        value_print(&v);
-        printf("\n");
-        frame->ip++;
-        break;
-      }
-      case OP_NOT: {
-        Value v = pop_stack();
-        bool data = !value_is_truthy(&v);
-        v.type = VAL_BOOL;
-        v.data.boolean = data;
-        push_stack(v);
-        frame->ip++;
-        break;
-      }
-      case OP_NEGATE: {
-        frame->ip += negate();
-        break;
-      }
-      case OP_CONSTANT: {
-        uint8_t index =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        Value constant =
-            *(Value*)frame->function->block->constants->data[index];
-        push_stack(constant);
-        frame->ip++;
-        break;
-      }
-      case OP_ADD: {
-        frame->ip += binary(TOKEN_PLUS);
-        break;
-      }
-      case OP_SUB: {
-        frame->ip += binary(TOKEN_MINUS);
-        break;
-      }
-      case OP_MUL: {
-        frame->ip += binary(TOKEN_STAR);
-        break;
-      }
-      case OP_DIV: {
-        frame->ip += binary(TOKEN_SLASH);
-        break;
-      }
-      case OP_LT: {
-        frame->ip += binary(TOKEN_LESS);
-        break;
-      }
-      case OP_GT: {
-        frame->ip += binary(TOKEN_GREATER);
-        break;
-      }
-      case OP_LTE: {
-        frame->ip += binary(TOKEN_LESS_EQUAL);
-        break;
-      }
-      case OP_GTE: {
-        frame->ip += binary(TOKEN_GREATER_EQUAL);
-        break;
-      }
-      case OP_EQ: {
-        frame->ip += binary(TOKEN_EQUAL_EQUAL);
-        break;
-      }
-      case OP_NEQ: {
-        frame->ip += binary(TOKEN_NOT_EQUAL);
-        break;
-      }
-      case OP_GLOBAL_DEFINE: {
-        Value name = pop_stack();
-        hash_table_set(&interpreter.globals, TO_STRING(name)->value,
-                       &value_new_null());
-        frame->ip++;
-        break;
-      }
-      case OP_GLOBAL_SET: {
-        Value name = pop_stack();
-        Value value = pop_stack();
-        hash_table_set(&interpreter.globals, TO_STRING(name)->value, &value);
-        frame->ip++;
-        break;
-      }
-      case OP_GLOBAL_GET: {
-        Value name = pop_stack();
-        Value value =
-            *hash_table_get(&interpreter.globals, TO_STRING(name)->value);
-        push_stack(value);
-        frame->ip++;
-        break;
-      }
-      case OP_LOCAL_GET: {
-        uint8_t index =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        push_stack(frame->slots[index]);
-        frame->ip++;
-        break;
-      }
-      case OP_LOCAL_SET: {
-        uint8_t index =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        frame->slots[index] = peek_stack(0);
-        if (interpreter.sp > (frame->slots - interpreter.stack) + index + 1)
-          pop_stack();
-        frame->ip++;
-        break;
-      }
-      case OP_FIELD_GET: {
-        frame->ip += field_get();
-        break;
+
+  uint8_t* code;
+  uint8_t* ip;
+  Value* constants;
+  InlineCache* caches;
+  Value* slots;
+  Value* sp;
+  reserve_stack(function->max_stack);
+  LOAD_FRAME();
+
+  VM_LOOP {
+    VM_CASE(OP_NOP) : { VM_DISPATCH(); }
+    VM_CASE(OP_POP) : {
+      if (sp == interpreter.stack) {
+        SAVE_FRAME();
+        runtime_error("pop from empty stack");
       }
-      case OP_FIELD_SET: {
-        frame->ip += field_set();
-        break;
+      sp--;
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_DUPE) : {
+      Value v = PEEK(0);
+      PUSH(v);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_SWAP) : {
+      Value a = sp[-1];
+      sp[-1] = sp[-2];
+      sp[-2] = a;
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_EXIT) : {
+      Value res = POP();
+      SAVE_FRAME();
+      return (InterpretResult)value_to_number(res);
+    }
+    VM_CASE(OP_CALL) : {
+      uint8_t arg_count = READ_BYTE();
+      Value callable = PEEK(arg_count);
+      SAVE_FRAME();
+      if (!value_is_object(callable))
+        runtime_error("Expected callable object type.");
+      if (value_as_object(callable)->type != P_OBJ_FUNCTION &&
+          value_as_object(callable)->type != P_OBJ_BUILTIN &&
+          value_as_object(callable)->type != P_OBJ_BOUND_METHOD &&
+          value_as_object(callable)->type != P_OBJ_STRUCT_TEMPLATE) {
+        runtime_error("Expected callable object type.");
       }
-      case OP_LIST: {
-        frame->ip += list();
-        break;
+      call_object(callable, arg_count);
+      LOAD_FRAME();
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_INVOKE) : {
+      InlineCache* cache = &caches[READ_BYTE()];
+      uint8_t arg_count = READ_BYTE();
+      CALL_SLOW(invoke, cache, arg_count);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_INVOKE_LONG) : {
+      InlineCache* cache = &caches[READ_U24()];
+      uint8_t arg_count = READ_BYTE();
+      CALL_SLOW(invoke, cache, arg_count);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_RETURN) : {
+      Value res = value_new_null();
+      // TODO: look at this potentially
+      if (sp - slots - (ptrdiff_t)frame->slotCount > 0)
+        res = POP();
+      pop_frame();
+      if (interpreter.fp <= 0) {
+        SAVE_FRAME();
+#ifdef POSITRON_DEBUG
+        if (DEBUG_MODE)
+          interpreter_print();
+#endif
+        return INTERPRET_OK;
       }
-      case OP_INDEX: {
-        frame->ip += list_index();
-        break;
+      // discard the callee's slots along with the callable below them
+      sp = slots - 1;
+      *sp++ = res;
+      interpreter.sp = (int)(sp - interpreter.stack);
+      frame = &interpreter.frames[interpreter.fp - 1];
+      LOAD_FRAME();
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_PRINT) : {
+      Value v = POP();
+      value_print(&v);
+      printf("\n");
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_NOT) : {
+      sp[-1] = value_new_boolean(!value_is_truthy(&sp[-1]));
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_NEGATE) : {
+      if (value_is_integer(sp[-1]) &&
+          value_as_integer(sp[-1]) != VALUE_INTEGER_MIN) {
+        sp[-1] = value_new_integer(-value_as_integer(sp[-1]));
+        VM_DISPATCH();
       }
-      case OP_CJUMPF: {
-        Value condition = pop_stack();
-        uint8_t high =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        uint8_t low =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        uint16_t offset = (high << 8) | low;
-        if (condition.data.boolean == false) {
-          frame->ip += offset;
-        } else {
-          frame->ip++;
-        }
-        break;
+      if (!value_is_numeric(sp[-1])) {
+        SAVE_FRAME();
+        runtime_error("Expected numeric value to negate.");
       }
-      case OP_CJUMPT: {
-        Value condition = pop_stack();
-        uint8_t high =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        uint8_t low =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        uint16_t offset = (high << 8) | low;
-        if (condition.data.boolean == true) {
-          frame->ip += offset;
-        } else {
-          frame->ip++;
-        }
-        break;
+      sp[-1] = value_new_number(-value_to_number(sp[-1]));
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_CONSTANT) : {
+      PUSH(constants[READ_BYTE()]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_CONSTANT_LONG) : {
+      size_t index = READ_U24();
+      PUSH(constants[index]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_ADD) : {
+      QUICKEN_BINARY(OP_ADD_INT, OP_ADD_NUM);
+      BINARY_ARITH_OP(integer_add, +);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_ADD_INT) : {
+      INTEGER_ARITH_OP(integer_add, OP_ADD);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_ADD_NUM) : {
+      NUMBER_BINARY_OP(value_new_number, +, OP_ADD);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_SUB) : {
+      QUICKEN_BINARY(OP_SUB_INT, OP_SUB_NUM);
+      BINARY_ARITH_OP(integer_sub, -);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_SUB_INT) : {
+      INTEGER_ARITH_OP(integer_sub, OP_SUB);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_SUB_NUM) : {
+      NUMBER_BINARY_OP(value_new_number, -, OP_SUB);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_MUL) : {
+      QUICKEN_BINARY(OP_MUL_INT, OP_MUL_NUM);
+      BINARY_ARITH_OP(integer_mul, *);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_MUL_INT) : {
+      INTEGER_ARITH_OP(integer_mul, OP_MUL);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_MUL_NUM) : {
+      NUMBER_BINARY_OP(value_new_number, *, OP_MUL);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_DIV) : {
+      Value b = POP();
+      Value a = POP();
+      if (!value_is_numeric(a) || !value_is_numeric(b)) {
+        SAVE_FRAME();
+        runtime_error("Undefined operation for given values.");
       }
-      case OP_JUMP: {
-        uint8_t high =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        uint8_t low =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        uint16_t offset = (high << 8) | low;
-        frame->ip += offset;
-        break;
+      if (value_to_number(b) == 0) {
+        SAVE_FRAME();
+        runtime_error("Division by zero.");
       }
-      case OP_JUMP_BACK: {
-        uint8_t high =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        uint8_t low =
-            *(uint8_t*)frame->function->block->opcodes->data[++frame->ip];
-        uint16_t offset = (high << 8) | low;
-        frame->ip -= offset;
-        break;
+      // integers divide to an integer only when the division is exact, MIN /
+      // -1 is ruled out first since the remainder would overflow too
+      if (value_is_integer(a) && value_is_integer(b) &&
+          !(value_as_integer(a) == VALUE_INTEGER_MIN &&
+            value_as_integer(b) == -1) &&
+          value_as_integer(a) % value_as_integer(b) == 0) {
+        *sp++ = value_new_integer(value_as_integer(a) / value_as_integer(b));
+        VM_DISPATCH();
       }
-      default: {
-        printf("Unknown opcode: %d\n",
-               *(uint8_t*)frame->function->block->opcodes->data[frame->ip]);
-        exit(1);
+      *sp++ = value_new_number(value_to_number(a) / value_to_number(b));
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LT) : {
+      QUICKEN_BINARY(OP_LT_INT, OP_LT_NUM);
+      BINARY_COMPARE_OP(<);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LT_INT) : {
+      INTEGER_COMPARE_OP(<, OP_LT);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LT_NUM) : {
+      NUMBER_BINARY_OP(value_new_boolean, <, OP_LT);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GT) : {
+      QUICKEN_BINARY(OP_GT_INT, OP_GT_NUM);
+      BINARY_COMPARE_OP(>);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GT_INT) : {
+      INTEGER_COMPARE_OP(>, OP_GT);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GT_NUM) : {
+      NUMBER_BINARY_OP(value_new_boolean, >, OP_GT);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LTE) : {
+      QUICKEN_BINARY(OP_LTE_INT, OP_LTE_NUM);
+      BINARY_COMPARE_OP(<=);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LTE_INT) : {
+      INTEGER_COMPARE_OP(<=, OP_LTE);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LTE_NUM) : {
+      NUMBER_BINARY_OP(value_new_boolean, <=, OP_LTE);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GTE) : {
+      QUICKEN_BINARY(OP_GTE_INT, OP_GTE_NUM);
+      BINARY_COMPARE_OP(>=);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GTE_INT) : {
+      INTEGER_COMPARE_OP(>=, OP_GTE);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GTE_NUM) : {
+      NUMBER_BINARY_OP(value_new_boolean, >=, OP_GTE);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_EQ) : {
+      Value b = POP();
+      Value a = POP();
+      *sp++ = value_new_boolean(values_equal(a, b));
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_NEQ) : {
+      Value b = POP();
+      Value a = POP();
+      *sp++ = value_new_boolean(!values_equal(a, b));
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GLOBAL_GET_SLOT) : {
+      PUSH(interpreter.globals[READ_BYTE()]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GLOBAL_SET_SLOT) : {
+      gc_global_barrier(sp[-1]);
+      interpreter.globals[READ_BYTE()] = POP();
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GLOBAL_GET_SLOT_LONG) : {
+      size_t slot = READ_U24();
+      PUSH(interpreter.globals[slot]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_GLOBAL_SET_SLOT_LONG) : {
+      size_t slot = READ_U24();
+      gc_global_barrier(sp[-1]);
+      interpreter.globals[slot] = POP();
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LOCAL_GET) : {
+      PUSH(slots[READ_BYTE()]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LOCAL_SET) : {
+      uint8_t index = READ_BYTE();
+      // a local being declared already sits in its slot
+      if (sp > slots + index + 1)
+        slots[index] = POP();
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LOCAL_GET_LONG) : {
+      size_t index = READ_U24();
+      PUSH(slots[index]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LOCAL_SET_LONG) : {
+      size_t index = READ_U24();
+      if (sp > slots + index + 1)
+        slots[index] = POP();
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_FIELD_GET) : {
+      FIELD_GET(&caches[READ_BYTE()]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_FIELD_SET) : {
+      FIELD_SET(&caches[READ_BYTE()]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_FIELD_GET_LONG) : {
+      FIELD_GET(&caches[READ_U24()]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_FIELD_SET_LONG) : {
+      FIELD_SET(&caches[READ_U24()]);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_LIST) : {
+      CALL_SLOW(list);
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_INDEX) : {
+      // in bounds integer indices into a list are read in place
+      Value target = sp[-2];
+      if (IS_TYPE(target, P_OBJ_LIST) && value_is_integer(sp[-1]) &&
+          (uint64_t)value_as_integer(sp[-1]) < TO_LIST(target)->count) {
+        sp[-2] = TO_LIST(target)->values[value_as_integer(sp[-1])];
+        sp--;
+      } else {
+        CALL_SLOW(list_index);
       }
+      VM_DISPATCH();
+    }
+    // jump offsets are relative to the last operand byte
+    VM_CASE(OP_CJUMPF) : {
+      Value condition = POP();
+      uint16_t offset = READ_U16();
+      if (!condition_is_true(condition))
+        ip += offset - 1;
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_CJUMPT) : {
+      Value condition = POP();
+      uint16_t offset = READ_U16();
+      if (condition_is_true(condition))
+        ip += offset - 1;
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_JUMP) : {
+      uint16_t offset = READ_U16();
+      ip += offset - 1;
+      VM_DISPATCH();
+    }
+    VM_CASE(OP_JUMP_BACK) : {
+      uint16_t offset = READ_U16();
+      ip -= offset + 1;
+      VM_DISPATCH();
+    }
+#ifndef POSITRON_COMPUTED_GOTO
+    default: {
+      SAVE_FRAME();
+      runtime_error("Unknown opcode: %d", ip[-1]);
     }
-  }
-
-#ifdef POSITRON_DEBUG
-  if (DEBUG_MODE)
-    interpreter_print();
 #endif
-
-  return INTERPRET_OK;
+  }
 }
 
 /**
@@ -689,7 +1145,7 @@ void interpreter_print() {
   printf("sp: %d,\n", interpreter.sp);
   printf("ip: %d,\n", (int)frame->ip);
   printf("opcode: ");
-  if (frame->ip < frame->function->block->opcodes->size) {
+  if (frame->ip < frame->function->block->size) {
     block_print_opcode(frame->function->block, frame->ip);
   }
   printf("\nstack: ");
@@ -708,7 +1164,11 @@ void interpreter_print() {
     printf("}");
   }
   printf("\nGlobals: ");
-  hash_table_print(&interpreter.globals);
+  for (size_t i = 0; i < interpreter.global_count; i++) {
+    printf("[");
+    value_print(&interpreter.globals[i]);
+    printf("]");
+  }
   printf("\n==========================================\n");
 }
 
@@ -716,14 +1176,13 @@ void interpreter_print() {
  * @brief Frees the memory allocated by the interpreter.
  */
 void interpreter_free() {
-  hash_table_free(&interpreter.globals);
-  hash_table_free(&interpreter.strings);
-
-  // Free the heap
-  PObject* object = interpreter.heap;
-  while (object != NULL) {
-    PObject* next = object->next;
-    p_object_free(object);
-    object = next;
-  }
+  free(interpreter.globals);
+  free(interpreter.stack);
+  free(interpreter.frames);
+  hash_table_free(&interpreter.list_methods);
+
+  // Free every object before the pool they were allocated from
+  string_table_free(&interpreter.strings);
+  gc_free();
+  pool_free();
 }
\ No newline at end of file
@@ -31,17 +31,26 @@ typedef struct CallFrame {
 typedef struct Interpreter {
     int fp;
     int sp;
-    Value stack[STACK_SIZE];
-    HashTable globals;
-    HashTable strings;
-    CallFrame frames[MAX_FRAMES];
-    PObject* heap;
+    Value* stack;
+    size_t stack_capacity;
+    Value* globals;
+    size_t global_count;
+    StringTable strings;
+    // builtin methods shared by every list
+    HashTable list_methods;
+    CallFrame* frames;
+    size_t frame_capacity;
+#ifdef POSITRON_PROFILE
+    uint64_t instructions;
+#endif
 } Interpreter;
 
 extern Interpreter interpreter;
 
 // Initialize the interpreter's memory.
 void interpreter_init();
+// Allocates the global slots assigned by the parser.
+void interpreter_define_globals(size_t count);
 // Interpret the emitted opcodes of a function.
 InterpretResult interpret(PFunction* function);
 // Prints the interpreter.
@@ -78,7 +78,7 @@ static Token make_token(enum TokenType type, const char* start, size_t length) {
  * @return Token* the token representing the number (floating point or integer)
  */
 static Token number() {
-  enum TokenType type = TOKEN_LITERAL_FLOATING;
+  enum TokenType type = TOKEN_LITERAL_INTEGER;
   const char* schar = lexer.input + lexer.index;
   int start = lexer.index;
   while (isdigit(peek()))
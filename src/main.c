@@ -7,16 +7,71 @@
  * @since 1/5/2023
  **/
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "gc.h"
 #include "interpreter.h"
 #include "lexer.h"
 #include "memory.h"
 #include "parser.h"
+#include "pool.h"
 #include "positron.h"
 
+/**
+ * @brief Parses the value of a size or count flag.
+ *
+ * @param flag the flag being parsed, for error messages
+ * @param value the flag's value, may be NULL if it was missing
+ * @return size_t the parsed size
+ */
+static size_t parse_size(const char* flag, const char* value) {
+  char* end = NULL;
+  unsigned long long size = value ? strtoull(value, &end, 10) : 0;
+  if (!value || *end != '\0' || size == 0) {
+    printf("Expected a positive number after %s\n", flag);
+    exit(1);
+  }
+  return (size_t)size;
+}
+
+/**
+ * @brief Parses the value of a stack or frame stack size flag. The
+ * interpreter indexes both stacks with an int, so larger sizes are rejected.
+ *
+ * @param flag the flag being parsed, for error messages
+ * @param value the flag's value, may be NULL if it was missing
+ * @return size_t the parsed size
+ */
+static size_t parse_stack_size(const char* flag, const char* value) {
+  size_t size = parse_size(flag, value);
+  if (size > INT_MAX) {
+    printf("Expected a number no larger than %d after %s\n", INT_MAX, flag);
+    exit(1);
+  }
+  return size;
+}
+
+/**
+ * @brief Parses the value of a duration flag given in milliseconds.
+ *
+ * @param flag the flag being parsed, for error messages
+ * @param value the flag's value, may be NULL if it was missing
+ * @return double the parsed duration
+ */
+static double parse_milliseconds(const char* flag, const char* value) {
+  char* end = NULL;
+  double milliseconds = value ? strtod(value, &end) : 0;
+  if (!value || *end != '\0' || !(milliseconds > 0)) {
+    printf("Expected a positive number of milliseconds after %s\n", flag);
+    exit(1);
+  }
+  return milliseconds;
+}
+
 int main(int argc, const char* argv[]) {
   if (argc < 2) {
     printf("Usage: %s <file>", argv[0]);
@@ -28,6 +83,31 @@ int main(int argc, const char* argv[]) {
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "-d") == 0) {
       DEBUG_MODE = true;
+    } else if (strcmp(argv[i], "--gc-stats") == 0) {
+      GC_STATS = true;
+    } else if (strcmp(argv[i], "--gc-incremental") == 0) {
+      GC_INCREMENTAL = true;
+    } else if (strcmp(argv[i], "--gc-max-pause") == 0) {
+      GC_INCREMENTAL = true;
+      GC_MAX_PAUSE = parse_milliseconds(argv[i], argv[i + 1]);
+      i++;
+    } else if (strcmp(argv[i], "--gc-threads") == 0) {
+      GC_THREADS = parse_size(argv[i], argv[i + 1]);
+      i++;
+    } else if (strcmp(argv[i], "--alloc-stats") == 0) {
+      ALLOC_STATS = true;
+    } else if (strcmp(argv[i], "--stack-size") == 0) {
+      STACK_SIZE = parse_stack_size(argv[i], argv[i + 1]);
+      i++;
+    } else if (strcmp(argv[i], "--stack-max") == 0) {
+      STACK_MAX = parse_stack_size(argv[i], argv[i + 1]);
+      i++;
+    } else if (strcmp(argv[i], "--frames-size") == 0) {
+      FRAMES_SIZE = parse_stack_size(argv[i], argv[i + 1]);
+      i++;
+    } else if (strcmp(argv[i], "--frames-max") == 0) {
+      FRAMES_MAX = parse_stack_size(argv[i], argv[i + 1]);
+      i++;
     } else if (strcmp(argv[i], "-h") == 0) {
       printf("Usage: %s <file>", argv[0]);
       exit(0);
@@ -45,24 +125,44 @@ int main(int argc, const char* argv[]) {
     exit(1);
   }
 
+  if (STACK_SIZE > STACK_MAX)
+    STACK_MAX = STACK_SIZE;
+  if (FRAMES_SIZE > FRAMES_MAX)
+    FRAMES_MAX = FRAMES_SIZE;
+
   const char* source = read_file(path);
 
+  // objects created while parsing live on the interpreter's heap
+  interpreter_init();
   lexer_init(source);
   parser_init(path);
 
-  InterpretResult result;
+  InterpretResult result = INTERPRET_FAIL;
 
   PFunction* script = parse_script(path);
 
   if (script) {
-    interpreter_init();
+    interpreter_define_globals(parser_global_count());
+#ifdef POSITRON_PROFILE
+    clock_t start = clock();
+#endif
 
     result = interpret(script);
 
-    interpreter_free();
+#ifdef POSITRON_PROFILE
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    fprintf(stderr, "%llu instructions in %.3fs (%.2f M instructions/s)\n",
+            (unsigned long long)interpreter.instructions, seconds,
+            interpreter.instructions / seconds / 1e6);
+#endif
+    if (GC_STATS)
+      gc_print_stats();
+    if (ALLOC_STATS)
+      pool_print_stats();
   }
 
   parser_free();
+  interpreter_free();
   free((void*)source);
 
   return (int)result;
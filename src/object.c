@@ -9,52 +9,85 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "gc.h"
 #include "interpreter.h"
 #include "object.h"
+#include "pool.h"
 #include "standard_lib.h"
 
+/**
+ * @brief Allocates an object, either young in the garbage collector's nursery
+ * or old and registered in its object table. This may run a collection
+ * first, which can move young objects, so anything the caller still needs
+ * must be reachable from the garbage collector's roots and read back from
+ * them afterwards.
+ *
+ * @param type the type of the object
+ * @param size the size of the object, including any trailing array
+ * @return PObject* the newly allocated object
+ */
 static PObject* _p_object_new(PObjectType type, size_t size) {
-  PObject* object = malloc(size);
-  object->type = type;
-
-  object->next = interpreter.heap;
-  interpreter.heap = object;
+  // an incremental collection in progress advances as the program allocates
+  if (gc.phase != GC_IDLE)
+    gc_step(size);
+  // the objects scripts create while running usually die young, everything
+  // else is made by the parser and lives until exit
+  bool young = (type == P_OBJ_LIST || type == P_OBJ_STRUCT_INSTANCE ||
+                type == P_OBJ_BOUND_METHOD) &&
+               size <= GC_LARGE_OBJECT;
+  if (young) {
+    PObject* object = gc_allocate_young(size);
+    object->type = type;
+    object->remembered = false;
+    object->forward = NULL;
+    return object;
+  }
 
+  gc_allocate(size);
+  PObject* object = pool_alloc(size);
+  object->type = type;
+  object->remembered = false;
+  gc_register(object);
   return object;
 }
 
 #define p_object_new(type, objType) (type*)_p_object_new(objType, sizeof(type))
 
 /**
- * @brief Allocates and returns a new string object.
+ * @brief Returns the string object holding the given characters. Strings are
+ * interned, so equal strings are always the same object and can be compared
+ * by pointer.
+ *
+ * @param data the characters of the string
+ * @param length the number of characters
+ * @return PString* the interned string
  */
 PString* p_object_string_new_n(const char* data, size_t length) {
-  PString* string = p_object_new(PString, P_OBJ_STRING);
-  string->length = length;
+  uint32_t hash = hashString(data, length);
+  PString* interned =
+      string_table_find(&interpreter.strings, data, length, hash);
+  if (interned != NULL)
+    return interned;
 
-  // TODO: handle string pooling
-
-  string->value = malloc(length + 1);
+  PString* string = (PString*)_p_object_new(
+      P_OBJ_STRING, sizeof(PString) + length + 1);
+  string->length = length;
+  string->hash = hash;
   memcpy(string->value, data, length);
   string->value[length] = '\0';
 
+  string_table_add(&interpreter.strings, string);
   return string;
 }
 
 /**
- * @brief Allocates a new pstring from a const char*.
+ * @brief Returns the interned string object for a const char*.
  *
  * @param data the data to copy into the string
- * @return PString* the newly allocated string
+ * @return PString* the interned string
  */
 PString* p_object_string_new(const char* data) {
-  PString* string = p_object_new(PString, P_OBJ_STRING);
-
-  // TODO: handle string pooling
-
-  string->length = strlen(data);
-  string->value = strdup(data);
-  return string;
+  return p_object_string_new_n(data, strlen(data));
 }
 
 /**
@@ -64,6 +97,7 @@ PFunction* p_object_function_new(PString* name) {
   PFunction* function = p_object_new(PFunction, P_OBJ_FUNCTION);
   function->name = name;
   function->arity = 0;
+  function->max_stack = 0;
   function->block = block_new();
   return function;
 }
@@ -72,12 +106,10 @@ PFunction* p_object_function_new(PString* name) {
  * @brief Allocates and returns a new builtin function object.
  *
  */
-PBuiltin* p_object_builtin_new(PObject* parent,
-                               PString* name,
+PBuiltin* p_object_builtin_new(PString* name,
                                BuiltinFn function,
                                size_t arity) {
   PBuiltin* builtin = p_object_new(PBuiltin, P_OBJ_BUILTIN);
-  builtin->parent = parent;
   builtin->name = name;
   builtin->arity = arity;
   builtin->function = *function;
@@ -99,38 +131,128 @@ PStructTemplate* p_object_struct_template_new(PString* name) {
 }
 
 /**
- * @brief Allocates and returns a new struct instance object.
+ * @brief Allocates and returns a new struct instance object, with its field
+ * slots allocated along with it and set to null.
  *
  * @param template the template of the struct
  * @return PStructInstance* the newly allocated struct instance
  */
 PStructInstance* p_object_struct_instance_new(PStructTemplate* template) {
-  PStructInstance* instance =
-      p_object_new(PStructInstance, P_OBJ_STRUCT_INSTANCE);
+  size_t count = template->fields.count;
+  PStructInstance* instance = (PStructInstance*)_p_object_new(
+      P_OBJ_STRUCT_INSTANCE, sizeof(PStructInstance) + sizeof(Value) * count);
   instance->template = template;
-  hash_table_init(&instance->fields);
+  instance->field_count = count;
+  for (size_t i = 0; i < count; i++)
+    instance->fields[i] = value_new_null();
   return instance;
 }
 
 /**
- * @brief Allocates and returns a new list object.
+ * @brief Allocates and returns a new list object. The values are stored
+ * contiguously in a separate array, which is not allocated for an empty list
+ * until the first value is appended.
  *
+ * @param capacity the number of values to make room for
  * @return PList* the newly allocated list
  */
-PList* p_object_list_new() {
+PList* p_object_list_new(size_t capacity) {
   PList* list = p_object_new(PList, P_OBJ_LIST);
-  list->list = dyn_list_new((void*)&value_free);
-  hash_table_init(&list->methods);
-  // TODO: add methods to list
-  hash_table_set(&list->methods, "size",
-                 &value_new_object(p_object_builtin_new(
-                     (PObject*)list, p_object_string_new("size"), &p_list_size, 0)));
-  hash_table_set(&list->methods, "add",
-                 &value_new_object(p_object_builtin_new(
-                     (PObject*)list, p_object_string_new("add"), &p_list_add, 1)));
+  list->values = NULL;
+  list->count = 0;
+  list->capacity = capacity;
+  if (capacity > 0) {
+    list->values = malloc(sizeof(Value) * capacity);
+    gc_track(sizeof(Value) * capacity);
+    if (!list->values) {
+      printf("Failed to allocate memory for list values.\n");
+      exit(1);
+    }
+  }
   return list;
 }
 
+/**
+ * @brief Appends a value to the end of a list, growing its array by
+ * LIST_GROW_FACTOR when it is full.
+ *
+ * @param list the list to append to
+ * @param value the value to append
+ */
+void p_object_list_append(PList* list, Value value) {
+  if (list->count == list->capacity) {
+    size_t old_capacity = list->capacity;
+    list->capacity = list->capacity < LIST_MIN_CAPACITY
+                         ? LIST_MIN_CAPACITY
+                         : list->capacity * LIST_GROW_FACTOR;
+    gc_track(sizeof(Value) * (list->capacity - old_capacity));
+    list->values = realloc(list->values, sizeof(Value) * list->capacity);
+    if (!list->values) {
+      printf("Failed to allocate memory for list values.\n");
+      exit(1);
+    }
+  }
+  list->values[list->count++] = value;
+  gc_write_barrier((PObject*)list, value);
+}
+
+/**
+ * @brief Allocates and returns a method bound to the object it was read from.
+ *
+ * @param receiver the object the method is called on
+ * @param method the builtin implementing the method
+ * @return PBoundMethod* the newly allocated bound method
+ */
+PBoundMethod* p_object_bound_method_new(PObject* receiver, PBuiltin* method) {
+  PBoundMethod* bound = p_object_new(PBoundMethod, P_OBJ_BOUND_METHOD);
+  bound->receiver = receiver;
+  bound->method = method;
+  return bound;
+}
+
+/**
+ * @brief Returns the number of bytes allocated for an object itself, including
+ * any array allocated along with it.
+ *
+ * @param object the object to measure
+ * @return size_t the size the object was allocated with
+ */
+size_t p_object_allocation_size(PObject* object) {
+  switch (object->type) {
+    case P_OBJ_STRING:
+      return sizeof(PString) + ((PString*)object)->length + 1;
+    case P_OBJ_FUNCTION:
+      return sizeof(PFunction);
+    case P_OBJ_BUILTIN:
+      return sizeof(PBuiltin);
+    case P_OBJ_STRUCT_TEMPLATE:
+      return sizeof(PStructTemplate);
+    case P_OBJ_STRUCT_INSTANCE:
+      return sizeof(PStructInstance) +
+             sizeof(Value) * ((PStructInstance*)object)->field_count;
+    case P_OBJ_LIST:
+      return sizeof(PList);
+    case P_OBJ_BOUND_METHOD:
+      return sizeof(PBoundMethod);
+    default:
+      return sizeof(PObject);
+  }
+}
+
+/**
+ * @brief Returns the number of bytes an object holds, matching what was
+ * recorded with the garbage collector when it and its memory were allocated.
+ *
+ * @param object the object to measure
+ * @return size_t the size of the object in bytes
+ */
+size_t p_object_size(PObject* object) {
+  size_t size = p_object_allocation_size(object);
+  if (object->type == P_OBJ_LIST)
+    size += sizeof(Value) * ((PList*)object)->capacity;
+  return size;
+}
+
 /**
  * @brief Outputs the objects type to stdout.
  *
@@ -156,6 +278,9 @@ void p_object_type_print(PObject* object) {
     case P_OBJ_LIST:
       printf("list");
       break;
+    case P_OBJ_BOUND_METHOD:
+      printf("bound method");
+      break;
     default:
       printf("object");
       break;
@@ -186,15 +311,18 @@ void p_object_print(PObject* object) {
     case P_OBJ_LIST: {
       PList* list = (PList*)object;
       printf("[");
-      for (size_t i = 0; i < list->list->size; i++) {
-        value_print((Value*)list->list->data[i]);
-        if (i != list->list->size - 1) {
+      for (size_t i = 0; i < list->count; i++) {
+        value_print(&list->values[i]);
+        if (i != list->count - 1) {
           printf(", ");
         }
       }
       printf("]");
       break;
     }
+    case P_OBJ_BOUND_METHOD:
+      printf("<builtin %s>", ((PBoundMethod*)object)->method->name->value);
+      break;
     default:
       printf("<object %p>", object);
       break;
@@ -202,15 +330,13 @@ void p_object_print(PObject* object) {
 }
 
 /**
- * @brief Frees the memory allocated by an object.
+ * @brief Frees the memory an object owns apart from the object itself. This
+ * only calls free(), so the garbage collector's sweeping threads can use it.
+ * Strings are not removed from the intern table here, the collector drops
+ * the unreachable ones before it frees them.
  */
-void p_object_free(PObject* object) {
+void p_object_release(PObject* object) {
   switch (object->type) {
-    case P_OBJ_STRING: {
-      PString* string = (PString*)object;
-      free(string->value);
-      break;
-    }
     case P_OBJ_FUNCTION: {
       PFunction* function = (PFunction*)object;
       block_free(function->block);
@@ -224,19 +350,20 @@ void p_object_free(PObject* object) {
       hash_table_free(&structTemplate->fields);
       break;
     }
-    case P_OBJ_STRUCT_INSTANCE: {
-      PStructInstance* struct_ = (PStructInstance*)object;
-      hash_table_free(&struct_->fields);
-      break;
-    }
     case P_OBJ_LIST: {
       PList* list = (PList*)object;
-      dyn_list_free(list->list);
-      hash_table_free(&list->methods);
+      free(list->values);
       break;
     }
     default:
       break;
   }
-  free(object);
+}
+
+/**
+ * @brief Frees the memory allocated by an object.
+ */
+void p_object_free(PObject* object) {
+  p_object_release(object);
+  pool_release(object, p_object_allocation_size(object));
 }
\ No newline at end of file
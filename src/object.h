@@ -11,13 +11,15 @@
 
 #define IS_TYPE(val, type) _p_object_check((val), (type))
 
-#define TO_STRING(val) ((PString*)(val).data.reference)
-#define TO_FUNCTION(val) ((PFunction*)(val).data.reference)
-#define TO_STRUCT(val) ((PStruct*)(val).data.reference)
-#define TO_STRUCT_INSTANCE(val) ((PStructInstance*)(val).data.reference)
-#define TO_LIST(val) ((PList*)(val).data.reference)
+#define TO_STRING(val) ((PString*)value_as_object(val))
+#define TO_FUNCTION(val) ((PFunction*)value_as_object(val))
+#define TO_STRUCT(val) ((PStruct*)value_as_object(val))
+#define TO_STRUCT_INSTANCE(val) ((PStructInstance*)value_as_object(val))
+#define TO_LIST(val) ((PList*)value_as_object(val))
+#define TO_BOUND_METHOD(val) ((PBoundMethod*)value_as_object(val))
 
 #define LIST_GROW_FACTOR 2
+#define LIST_MIN_CAPACITY 8
 
 #include <stdint.h>
 
@@ -33,32 +35,46 @@ typedef enum PObjectType {
   P_OBJ_BUILTIN,
   P_OBJ_STRUCT_TEMPLATE,
   P_OBJ_STRUCT_INSTANCE,
-  P_OBJ_LIST
+  P_OBJ_LIST,
+  P_OBJ_BOUND_METHOD
 } PObjectType;
 
 struct PObject {
   PObjectType type;
-  PObject* next;
+  // set while an old object is in the garbage collector's remembered set
+  bool remembered;
+  union {
+    // an old object's index in the garbage collector's object table, which
+    // also locates its mark bit
+    size_t slot;
+    // the copy a young object was promoted to, NULL until then
+    PObject* forward;
+  };
 };
 
-typedef struct PString {
+struct PString {
   PObject base;
-  char* value;
   size_t length;
-} PString;
+  // hash of the characters, computed once when the string is interned
+  uint32_t hash;
+  // the characters, null terminated and allocated along with the string
+  char value[];
+};
 
 typedef struct PFunction {
   PObject base;
   PString* name;
   Block* block;
   size_t arity;
+  // deepest the stack gets above the function's slots, arguments included
+  size_t max_stack;
 } PFunction;
 
-typedef Value (*BuiltinFn)(PObject* parent, size_t argc, Value* args);
+// receiver is the object a method is called on, NULL for plain functions
+typedef Value (*BuiltinFn)(PObject* receiver, size_t argc, Value* args);
 
 typedef struct PBuiltin {
   PObject base;
-  PObject* parent;
   PString* name;
   size_t arity;
   BuiltinFn function;
@@ -67,45 +83,72 @@ typedef struct PBuiltin {
 typedef struct PStructTemplate {
   PObject base;
   PString* name;
+  // maps each field name to its slot in the instances' fields
   HashTable fields;
 } PStructTemplate;
 
 typedef struct PStructInstance {
   PObject base;
   PStructTemplate* template;
-  HashTable fields;
+  // the template's field count, kept so the instance can be sized when it is
+  // freed after its template
+  size_t field_count;
+  // one slot per template field, in declaration order
+  Value fields[];
 } PStructInstance;
 
 typedef struct PList {
   PObject base;
-  HashTable methods;
-  dyn_list* list;
+  // elements stored contiguously, methods are shared by all lists (see
+  // interpreter.list_methods)
+  Value* values;
+  size_t count;
+  size_t capacity;
 } PList;
 
-// allocates and returns a new PString.
+// a builtin method read off its receiver, calling it passes the receiver
+typedef struct PBoundMethod {
+  PObject base;
+  PObject* receiver;
+  PBuiltin* method;
+} PBoundMethod;
+
+// returns the interned PString with the given characters, allocating it if
+// it does not exist yet.
 PString* p_object_string_new_n(const char* data, size_t length);
 PString* p_object_string_new(const char* data);
 // allocates and returns a new PFunction.
 PFunction* p_object_function_new(PString* name);
 // allocates and returns a new PBuiltin.
-PBuiltin* p_object_builtin_new(PObject* parent, PString* name, BuiltinFn function, size_t argc);
+PBuiltin* p_object_builtin_new(PString* name, BuiltinFn function, size_t argc);
 // allocates and returns a new PStructTemplate.
 PStructTemplate* p_object_struct_template_new(PString* name);
 // allocates and returns a new PStructInstance.
 PStructInstance* p_object_struct_instance_new(PStructTemplate* template);
-// allocates and returns a new PList.
-PList* p_object_list_new();
+// allocates and returns a new PList with room for capacity values.
+PList* p_object_list_new(size_t capacity);
+// appends a value to the end of a PList, growing it if needed.
+void p_object_list_append(PList* list, Value value);
+// allocates and returns a new PBoundMethod.
+PBoundMethod* p_object_bound_method_new(PObject* receiver, PBuiltin* method);
+// returns the number of bytes the given PObject was allocated with.
+size_t p_object_allocation_size(PObject* object);
+// returns the number of bytes the given PObject holds, counting the memory it
+// owns such as a string's characters or a list's elements.
+size_t p_object_size(PObject* object);
 // prints the type of the given PObject.
 void p_object_type_print(PObject* object);
 // prints the given PObject.
 void p_object_print(PObject* object);
+// frees the memory the given PObject owns, but not the PObject itself.
+void p_object_release(PObject* object);
 // frees the given PObject.
 void p_object_free(PObject* object);
 
 // inline helper for macro
 static inline bool _p_object_check(Value value, PObjectType type) {
-  return value.type == VAL_OBJ &&
-         ((PObject*)value.data.reference)->type == type;
+  return value_is_object(value) &&
+         value_as_object(value)->type == type;
 }
 
 #endif
\ No newline at end of file
@@ -9,8 +9,10 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "gc.h"
 #include "lexer.h"
 #include "parser.h"
 #include "positron.h"
@@ -108,18 +110,44 @@ void parse_error(const char* format, ...) {
 void parser_init() {
   parser.function = NULL;
   parser.scope = 0;
+  parser.locals = NULL;
   parser.local_count = 0;
+  parser.local_capacity = 0;
   hash_table_init(&parser.globals);
-  init_standard_lib(&parser.globals);
+  hash_table_init(&parser.builtins);
+  parser.global_count = 0;
 
   advance();
 }
 
+/**
+ * @brief Returns the number of global slots assigned while parsing, which is
+ * the size of the interpreter's global array.
+ *
+ * @return size_t the number of global slots.
+ */
+size_t parser_global_count() {
+  return parser.global_count;
+}
+
+/**
+ * @brief Marks the function being parsed and the names and builtins the
+ * parser has created. Enclosing functions and objects that are only held by
+ * parsing functions' locals are pinned with gc_pin() instead.
+ */
+void parser_mark_roots() {
+  gc_mark_object((PObject*)parser.function);
+  gc_mark_table(&parser.globals);
+  gc_mark_table(&parser.builtins);
+}
+
 /**
  * @brief Frees the parser's memory.
  */
 void parser_free() {
   hash_table_free(&parser.globals);
+  hash_table_free(&parser.builtins);
+  free(parser.locals);
 }
 
 /**
@@ -161,7 +189,7 @@ static void pop_locals() {
     if (parser.locals[i].depth <= parser.scope)
       break;
 
-    block_new_opcode(parser.function->block, OP_POP);
+    block_new_opcode(parser.function->block, OP_POP, parser.previous.line);
     parser.local_count--;
   }
 }
@@ -192,7 +220,7 @@ static int get_local(Token* name) {
  * @return int the index of the local
  */
 static int new_local(Token* name) {
-  if (parser.local_count == UINT8_MAX) {
+  if (parser.local_count == MAX_LOCALS) {
     parse_error("Too many local variables in scope\n");
     return -1;
   }
@@ -202,12 +230,64 @@ static int new_local(Token* name) {
     printf("'\n");
     return -1;
   }
+  if (parser.local_count == parser.local_capacity) {
+    parser.local_capacity = parser.local_capacity < INITIAL_CAPACITY
+                                ? INITIAL_CAPACITY
+                                : parser.local_capacity * GROWTH_FACTOR;
+    parser.locals =
+        realloc(parser.locals, sizeof(Local) * parser.local_capacity);
+  }
   parser.locals[parser.local_count].name = *name;
   parser.locals[parser.local_count].depth = parser.scope;
   parser.local_count++;
   return parser.local_count - 1;
 }
 
+/**
+ * @brief Finds the slot of a global variable.
+ *
+ * @param name the name of the global
+ * @return int the slot of the global or -1 if it is not defined
+ */
+static int get_global(PString* name) {
+  Value* slot = hash_table_get(&parser.globals, name);
+  return slot ? (int)value_as_integer(*slot) : -1;
+}
+
+/**
+ * @brief Assigns a global variable the next free slot in the interpreter's
+ * global array. Redeclaring a global reuses its slot.
+ *
+ * @param name the name of the global
+ * @return int the slot of the global or -1 if there are too many globals
+ */
+static int new_global(PString* name) {
+  int slot = get_global(name);
+  if (slot != -1)
+    return slot;
+  if (parser.global_count > MAX_LONG_OPERAND) {
+    parse_error("Too many global variables\n");
+    return -1;
+  }
+  slot = parser.global_count++;
+  hash_table_set(&parser.globals, name, value_new_integer(slot));
+  return slot;
+}
+
+/**
+ * @brief Emits the opcode that stores the value on top of the stack in a
+ * global slot.
+ *
+ * @param slot the slot of the global
+ */
+static void global_set(int slot) {
+  if (slot != -1)
+    block_new_opcode_operand(parser.function->block, OP_GLOBAL_SET_SLOT,
+                             OP_GLOBAL_SET_SLOT_LONG, slot,
+                             parser.previous.line);
+  parser.consumed_end = parser.function->block->size;
+}
+
 static void expression(Precedence prec);
 
 /**
@@ -221,18 +301,24 @@ static void variable(bool canAssign) {
     if (index != -1) {
       if (canAssign && match(TOKEN_EQUAL)) {
         expression(PREC_ASSIGNMENT);
-        block_new_opcodes(parser.function->block, OP_LOCAL_SET, index);
+        block_new_opcode_operand(parser.function->block, OP_LOCAL_SET,
+                                 OP_LOCAL_SET_LONG, index,
+                                 parser.previous.line);
+        // assigning to a declared local always pops the value
+        block_adjust_stack(parser.function->block, -1);
+        parser.consumed_end = parser.function->block->size;
       } else {
-        block_new_opcodes(parser.function->block, OP_LOCAL_GET, index);
+        block_new_opcode_operand(parser.function->block, OP_LOCAL_GET,
+                                 OP_LOCAL_GET_LONG, index,
+                                 parser.previous.line);
       }
       return;
     }
   }
 
   PString* name = p_object_string_new_n(token.start, token.length);
-
-  Value* val = hash_table_get(&parser.globals, name->value);
-  if (val == NULL) {
+  Value* global = hash_table_get(&parser.globals, name);
+  if (global == NULL) {
     parse_error("Undefined variable '");
     token_print_lexeme(&token);
     printf("'\n");
@@ -241,16 +327,30 @@ static void variable(bool canAssign) {
 
   if (canAssign && match(TOKEN_EQUAL)) {
     expression(PREC_ASSIGNMENT);
-    block_new_opcodes_3(parser.function->block, OP_CONSTANT,
-                        block_new_constant(parser.function->block,
-                                           &value_new_object((PObject*)name)),
-                        OP_GLOBAL_SET);
+    global_set(value_as_integer(*global));
   } else {
-    block_new_opcodes_3(parser.function->block, OP_CONSTANT,
-                        block_new_constant(parser.function->block,
-                                           &value_new_object((PObject*)name)),
-                        OP_GLOBAL_GET);
+    block_new_opcode_operand(parser.function->block, OP_GLOBAL_GET_SLOT,
+                             OP_GLOBAL_GET_SLOT_LONG,
+                             value_as_integer(*global),
+                             parser.previous.line);
+  }
+}
+
+/**
+ * @brief Converts the previous token to a floating point number. The token is
+ * not null terminated, so it is copied first.
+ */
+static Value number_literal(void) {
+  char* buffer = malloc(parser.previous.length + 1);
+  if (!buffer) {
+    printf("Failed to allocate memory for a number literal.\n");
+    exit(1);
   }
+  memcpy(buffer, parser.previous.start, parser.previous.length);
+  buffer[parser.previous.length] = '\0';
+  Value val = value_new_number(strtod(buffer, NULL));
+  free(buffer);
+  return val;
 }
 
 /**
@@ -259,30 +359,43 @@ static void variable(bool canAssign) {
 static void literal(bool canAssign) {
   enum TokenType type = parser.previous.type;
 
-  if (type == TOKEN_LITERAL_FLOATING) {
-    char buffer[200];
-    strncpy(buffer, parser.previous.start, parser.previous.length);
-    buffer[parser.previous.length] = '\0';
-    Value val = value_new_number(atof(buffer));
-    uint8_t index = block_new_constant(parser.function->block, &val);
-    block_new_opcodes(parser.function->block, OP_CONSTANT, index);
+  if (type == TOKEN_LITERAL_INTEGER) {
+    // the token is only digits, negative literals are negated at runtime
+    int64_t integer = 0;
+    bool overflow = false;
+    for (int i = 0; i < parser.previous.length; i++) {
+      int digit = parser.previous.start[i] - '0';
+      if (integer > (VALUE_INTEGER_MAX - digit) / 10) {
+        overflow = true;
+        break;
+      }
+      integer = integer * 10 + digit;
+    }
+    // integers too large to represent are stored as numbers instead
+    Value val = overflow ? number_literal() : value_new_integer(integer);
+    block_new_constant_opcode(parser.function->block, &val,
+                              parser.previous.line);
+  } else if (type == TOKEN_LITERAL_FLOATING) {
+    Value val = number_literal();
+    block_new_constant_opcode(parser.function->block, &val,
+                              parser.previous.line);
   } else if (type == TOKEN_LITERAL_STRING) {
     Value val = value_new_object((PObject*)p_object_string_new_n(
         parser.previous.start, parser.previous.length));
-    uint8_t index = block_new_constant(parser.function->block, &val);
-    block_new_opcodes(parser.function->block, OP_CONSTANT, index);
+    block_new_constant_opcode(parser.function->block, &val,
+                              parser.previous.line);
   } else if (type == TOKEN_NULL) {
     Value val = value_new_null();
-    uint8_t index = block_new_constant(parser.function->block, &val);
-    block_new_opcodes(parser.function->block, OP_CONSTANT, index);
+    block_new_constant_opcode(parser.function->block, &val,
+                              parser.previous.line);
   } else if (type == TOKEN_TRUE) {
     Value val = value_new_boolean(true);
-    uint8_t index = block_new_constant(parser.function->block, &val);
-    block_new_opcodes(parser.function->block, OP_CONSTANT, index);
+    block_new_constant_opcode(parser.function->block, &val,
+                              parser.previous.line);
   } else if (type == TOKEN_FALSE) {
     Value val = value_new_boolean(false);
-    uint8_t index = block_new_constant(parser.function->block, &val);
-    block_new_opcodes(parser.function->block, OP_CONSTANT, index);
+    block_new_constant_opcode(parser.function->block, &val,
+                              parser.previous.line);
   } else if (type == TOKEN_IDENTIFIER) {
     return variable(canAssign);
   } else {
@@ -311,11 +424,11 @@ static void unary(bool canAssign) {
 
   switch (prev) {
     case TOKEN_MINUS: {
-      block_new_opcode(parser.function->block, OP_NEGATE);
+      block_new_opcode(parser.function->block, OP_NEGATE, parser.previous.line);
       break;
     }
     case TOKEN_EXCLAMATION: {
-      block_new_opcode(parser.function->block, OP_NOT);
+      block_new_opcode(parser.function->block, OP_NOT, parser.previous.line);
       break;
     }
     default: {
@@ -325,18 +438,37 @@ static void unary(bool canAssign) {
   }
 }
 
+/**
+ * @brief Checks that a jump's distance fits in its two byte operand.
+ *
+ * @param distance the number of bytes to jump over
+ * @return uint16_t the distance, or 0 after reporting a parse error
+ */
+static uint16_t jump_size(int distance) {
+  if (distance > UINT16_MAX) {
+    // a loop reports this for both of its jumps, once is enough
+    if (!parser.had_error)
+      parse_error("Too much code to jump over\n");
+    return 0;
+  }
+  return distance;
+}
+
 /**
  * @brief Parses a logical expression for and.
  */
 static void and (bool canAssign) {
-  block_new_opcodes_3(parser.function->block, OP_CJUMPF, 0, 0);
-  int start = parser.function->block->opcodes->size;
+  // the left value is kept as the result when it is false and popped before
+  // the right value replaces it otherwise, either way one value is left
+  block_new_opcode(parser.function->block, OP_DUPE, parser.previous.line);
+  block_new_opcodes_3(
+      parser.function->block, OP_CJUMPF, 0, 0, parser.previous.line);
+  int start = parser.function->block->size;
+  block_new_opcode(parser.function->block, OP_POP, parser.previous.line);
   expression(PREC_AND);
-  int end = parser.function->block->opcodes->size;
-  uint16_t dist = end - start + 1;
-  (*(uint8_t*)parser.function->block->opcodes->data[start - 2]) =
-      (dist >> 8) & 0xFF;
-  (*(uint8_t*)parser.function->block->opcodes->data[start - 1]) = dist & 0xFF;
+  int end = parser.function->block->size;
+  uint16_t dist = jump_size(end - start + 1);
+  block_patch_u16(parser.function->block, start - 2, dist);
 }
 
 /**
@@ -346,15 +478,15 @@ static void and (bool canAssign) {
  * @return Value
  */
 static void or (bool canAssign) {
-  block_new_opcode(parser.function->block, OP_DUPE);
-  block_new_opcodes_3(parser.function->block, OP_CJUMPT, 0, 0);
-  int start = parser.function->block->opcodes->size;
+  block_new_opcode(parser.function->block, OP_DUPE, parser.previous.line);
+  block_new_opcodes_3(
+      parser.function->block, OP_CJUMPT, 0, 0, parser.previous.line);
+  int start = parser.function->block->size;
+  block_new_opcode(parser.function->block, OP_POP, parser.previous.line);
   expression(PREC_OR);
-  int end = parser.function->block->opcodes->size;
-  uint16_t dist = end - start + 1;
-  (*(uint8_t*)parser.function->block->opcodes->data[start - 2]) =
-      (dist >> 8) & 0xFF;
-  (*(uint8_t*)parser.function->block->opcodes->data[start - 1]) = dist & 0xFF;
+  int end = parser.function->block->size;
+  uint16_t dist = jump_size(end - start + 1);
+  block_patch_u16(parser.function->block, start - 2, dist);
 }
 
 /**
@@ -367,43 +499,43 @@ static void binary(bool canAssign) {
 
   switch (prev) {
     case TOKEN_PLUS: {
-      block_new_opcode(parser.function->block, OP_ADD);
+      block_new_opcode(parser.function->block, OP_ADD, parser.previous.line);
       break;
     }
     case TOKEN_MINUS: {
-      block_new_opcode(parser.function->block, OP_SUB);
+      block_new_opcode(parser.function->block, OP_SUB, parser.previous.line);
       break;
     }
     case TOKEN_STAR: {
-      block_new_opcode(parser.function->block, OP_MUL);
+      block_new_opcode(parser.function->block, OP_MUL, parser.previous.line);
       break;
     }
     case TOKEN_SLASH: {
-      block_new_opcode(parser.function->block, OP_DIV);
+      block_new_opcode(parser.function->block, OP_DIV, parser.previous.line);
       break;
     }
     case TOKEN_LESS: {
-      block_new_opcode(parser.function->block, OP_LT);
+      block_new_opcode(parser.function->block, OP_LT, parser.previous.line);
       break;
     }
     case TOKEN_LESS_EQUAL: {
-      block_new_opcode(parser.function->block, OP_LTE);
+      block_new_opcode(parser.function->block, OP_LTE, parser.previous.line);
       break;
     }
     case TOKEN_GREATER: {
-      block_new_opcode(parser.function->block, OP_GT);
+      block_new_opcode(parser.function->block, OP_GT, parser.previous.line);
       break;
     }
     case TOKEN_GREATER_EQUAL: {
-      block_new_opcode(parser.function->block, OP_GTE);
+      block_new_opcode(parser.function->block, OP_GTE, parser.previous.line);
       break;
     }
     case TOKEN_EQUAL_EQUAL: {
-      block_new_opcode(parser.function->block, OP_EQ);
+      block_new_opcode(parser.function->block, OP_EQ, parser.previous.line);
       break;
     }
     case TOKEN_NOT_EQUAL: {
-      block_new_opcode(parser.function->block, OP_NEQ);
+      block_new_opcode(parser.function->block, OP_NEQ, parser.previous.line);
       break;
     }
     default: {
@@ -414,13 +546,12 @@ static void binary(bool canAssign) {
 }
 
 /**
- * @brief Descent case for calling a function. Calls the function and returns
- * its result.
+ * @brief Parses the arguments of a call up to and including the closing
+ * parenthesis, leaving them on the stack.
  *
- * @param fun the function to call
- * @return Value the result of the function call
+ * @return uint8_t the number of arguments
  */
-static void call(bool canAssign) {
+static uint8_t argument_list() {
   size_t argc = 0;
   while (!check(TOKEN_RPAREN)) {
     if (argc > 0) {
@@ -431,10 +562,23 @@ static void call(bool canAssign) {
   }
   if (argc > 255) {
     parse_error("Cannot call function with more than 255 arguments\n");
-    return;
+    return 0;
   }
   consume(TOKEN_RPAREN);
-  block_new_opcodes(parser.function->block, OP_CALL, argc);
+  return (uint8_t)argc;
+}
+
+/**
+ * @brief Descent case for calling a function. Calls the function and returns
+ * its result.
+ *
+ * @param fun the function to call
+ * @return Value the result of the function call
+ */
+static void call(bool canAssign) {
+  uint8_t argc = argument_list();
+  block_new_opcodes(
+      parser.function->block, OP_CALL, argc, parser.previous.line);
 
   return;
 }
@@ -448,19 +592,26 @@ static void dot(bool canAssign) {
   PString* name =
       p_object_string_new_n(parser.previous.start, parser.previous.length);
 
+  size_t cache = block_new_cache(parser.function->block, name);
+
   if (match(TOKEN_EQUAL)) {
     expression(PREC_ASSIGNMENT);
-    block_new_opcodes_3(
-        parser.function->block, OP_CONSTANT,
-        block_new_constant(parser.function->block, &value_new_object(name)),
-        OP_FIELD_SET);
+    block_new_opcode_operand(parser.function->block, OP_FIELD_SET,
+                             OP_FIELD_SET_LONG, cache, parser.previous.line);
+    parser.consumed_end = parser.function->block->size;
     return;
   }
 
-  block_new_opcodes_3(
-      parser.function->block, OP_CONSTANT,
-      block_new_constant(parser.function->block, &value_new_object(name)),
-      OP_FIELD_GET);
+  // a call right after the access is fused into a single method call
+  if (match(TOKEN_LPAREN)) {
+    uint8_t argc = argument_list();
+    block_new_invoke(parser.function->block, cache, argc,
+                     parser.previous.line);
+    return;
+  }
+
+  block_new_opcode_operand(parser.function->block, OP_FIELD_GET,
+                           OP_FIELD_GET_LONG, cache, parser.previous.line);
 }
 
 /**
@@ -479,15 +630,15 @@ static void list(bool canAssign) {
     count++;
   }
   consume(TOKEN_RBRACKET);
-  block_new_opcodes(
-      parser.function->block, OP_CONSTANT,
-      block_new_constant(parser.function->block, &value_new_number(count)));
-  block_new_opcode(parser.function->block, OP_LIST);
+  block_new_constant_opcode(parser.function->block, &value_new_integer(count),
+                            parser.previous.line);
+  block_new_opcode(parser.function->block, OP_LIST, parser.previous.line);
+  block_adjust_stack(parser.function->block, -(int)count);
 }
 
 static void list_index(bool canAssign) {
   expression(PREC_ASSIGNMENT);
-  block_new_opcode(parser.function->block, OP_INDEX);
+  block_new_opcode(parser.function->block, OP_INDEX, parser.previous.line);
 }
 
 /**
@@ -497,7 +648,8 @@ static void list_index(bool canAssign) {
  * @param canAssign whether or not the expression can be assigned to
  */
 static void drop_ref(bool canAssign) {
-  block_new_opcode(parser.function->block, OP_POP);
+  block_new_opcode(parser.function->block, OP_POP, parser.previous.line);
+  parser.consumed_end = parser.function->block->size;
 }
 
 /**
@@ -534,6 +686,18 @@ static void expression(Precedence prec) {
   }
 }
 
+/**
+ * @brief Parses an expression whose value is not used and pops it, so every
+ * statement leaves the stack as deep as it found it. Assignments and values
+ * dropped with ! already leave nothing behind and are left alone.
+ */
+static void expression_statement() {
+  parser.consumed_end = SIZE_MAX;
+  expression(PREC_ASSIGNMENT);
+  if (parser.consumed_end != parser.function->block->size)
+    block_new_opcode(parser.function->block, OP_POP, parser.previous.line);
+}
+
 /**
  * @brief Parses an if statement.
  */
@@ -542,32 +706,27 @@ static void statement_if() {
   expression(PREC_ASSIGNMENT);
   consume(TOKEN_RPAREN);
 
-  block_new_opcodes_3(parser.function->block, OP_CJUMPF, 0xFF, 0xFF);
-  size_t start = parser.function->block->opcodes->size - 2;
+  block_new_opcodes_3(
+      parser.function->block, OP_CJUMPF, 0xFF, 0xFF, parser.previous.line);
+  size_t start = parser.function->block->size - 2;
   statement();
   if (match(TOKEN_ELSE)) {
-    block_new_opcodes_3(parser.function->block, OP_JUMP, 0xFF, 0xFF);
-    size_t start2 = parser.function->block->opcodes->size - 2;
+    block_new_opcodes_3(
+        parser.function->block, OP_JUMP, 0xFF, 0xFF, parser.previous.line);
+    size_t start2 = parser.function->block->size - 2;
 
-    int jump = parser.function->block->opcodes->size - start - 1;
-    uint16_t size = jump < UINT16_MAX ? jump : UINT16_MAX;
-    (*(uint8_t*)parser.function->block->opcodes->data[start]) =
-        (size >> 8) & 0xFF;
-    (*(uint8_t*)parser.function->block->opcodes->data[start + 1]) = size & 0xFF;
+    int jump = parser.function->block->size - start - 1;
+    uint16_t size = jump_size(jump);
+    block_patch_u16(parser.function->block, start, size);
 
     statement();
-    jump = parser.function->block->opcodes->size - start2 - 1;
-    size = jump < UINT16_MAX ? jump : UINT16_MAX;
-    (*(uint8_t*)parser.function->block->opcodes->data[start2]) =
-        (size >> 8) & 0xFF;
-    (*(uint8_t*)parser.function->block->opcodes->data[start2 + 1]) =
-        size & 0xFF;
+    jump = parser.function->block->size - start2 - 1;
+    size = jump_size(jump);
+    block_patch_u16(parser.function->block, start2, size);
   } else {
-    int jump = parser.function->block->opcodes->size - start - 1;
-    uint16_t size = jump < UINT16_MAX ? jump : UINT16_MAX;
-    (*(uint8_t*)parser.function->block->opcodes->data[start]) =
-        (size >> 8) & 0xFF;
-    (*(uint8_t*)parser.function->block->opcodes->data[start + 1]) = size & 0xFF;
+    int jump = parser.function->block->size - start - 1;
+    uint16_t size = jump_size(jump);
+    block_patch_u16(parser.function->block, start, size);
   }
 }
 
@@ -582,8 +741,9 @@ static void statement_function() {
   consume(TOKEN_LPAREN);
 
   PString* fname = p_object_string_new_n(name, length);
-  Value fnameVal = value_new_object((PObject*)fname);
+  gc_pin((PObject*)fname);
   PFunction* function = p_object_function_new(fname);
+  gc_pin((PObject*)function);
 
   parser.scope++;
   size_t args = 0;
@@ -596,29 +756,29 @@ static void statement_function() {
       consume(TOKEN_COMMA);
   }
   function->arity = args;
+  // the arguments are already on the stack when the body starts
+  block_adjust_stack(function->block, args);
   parser.scope--;
 
   Value fval = value_new_object((PObject*)function);
   // TODO: need support for local functions
+  int slot = -1;
   if (!parser.scope) {
-    // global function
-    if (!hash_table_set(&parser.globals, fname->value, &fval))
+    // global function, defined before the body so it can recurse
+    if (get_global(fname) != -1)
       parse_error("Global function '%s' already defined\n", fname->value);
+    else
+      slot = new_global(fname);
   } else {
     parse_error("Local functions not yet supported\n");
   }
 
   parse_function(function);
 
-  uint8_t index = block_new_constant(parser.function->block, &fnameVal);
-
-  block_new_opcodes(parser.function->block, OP_CONSTANT, index);
-  block_new_opcode(parser.function->block, OP_GLOBAL_DEFINE);
-
-  block_new_opcodes(parser.function->block, OP_CONSTANT,
-                    block_new_constant(parser.function->block, &fval));
-  block_new_opcodes(parser.function->block, OP_CONSTANT, index);
-  block_new_opcode(parser.function->block, OP_GLOBAL_SET);
+  block_new_constant_opcode(parser.function->block, &fval,
+                            parser.previous.line);
+  gc_unpin(2);
+  global_set(slot);
 }
 
 /**
@@ -638,7 +798,10 @@ static void statement_declaration_local() {
     printf("' already declared.\n");
   }
 
-  block_new_opcodes(parser.function->block, OP_LOCAL_SET, new_local(&name));
+  int index = new_local(&name);
+  if (index != -1)
+    block_new_opcode_operand(parser.function->block, OP_LOCAL_SET,
+                             OP_LOCAL_SET_LONG, index, parser.previous.line);
 }
 
 /**
@@ -648,20 +811,15 @@ static void statement_declaration_global() {
   consume(TOKEN_IDENTIFIER);
   Token* name = &parser.previous;
   PString* pstr = p_object_string_new_n(name->start, name->length);
-  Value vname = value_new_object((PObject*)pstr);
-  uint8_t index = block_new_constant(parser.function->block, &vname);
-
-  block_new_opcodes(parser.function->block, OP_CONSTANT, index);
-  block_new_opcode(parser.function->block, OP_GLOBAL_DEFINE);
+  gc_pin((PObject*)pstr);
 
   consume(TOKEN_EQUAL);
 
   expression(PREC_ASSIGNMENT);
 
-  hash_table_set(&parser.globals, pstr->value, &value_new_boolean(false));
-
-  block_new_opcodes(parser.function->block, OP_CONSTANT, index);
-  block_new_opcode(parser.function->block, OP_GLOBAL_SET);
+  // the global is declared after its initializer so it cannot refer to itself
+  global_set(new_global(pstr));
+  gc_unpin(1);
 }
 
 /**
@@ -679,29 +837,27 @@ static void statement_declaration() {
  */
 static void statement_while() {
   consume(TOKEN_LPAREN);
-  int start = parser.function->block->opcodes->size;
+  int start = parser.function->block->size;
   expression(PREC_ASSIGNMENT);
   consume(TOKEN_RPAREN);
   // check the conditional, if it's false, jump to after the loop
-  block_new_opcodes_3(parser.function->block, OP_CJUMPF, 0xFF, 0xFF);
-  int codes = parser.function->block->opcodes->size - 2;
+  block_new_opcodes_3(
+      parser.function->block, OP_CJUMPF, 0xFF, 0xFF, parser.previous.line);
+  int codes = parser.function->block->size - 2;
   statement();
 
-  int end = parser.function->block->opcodes->size;
+  int end = parser.function->block->size;
   int jump = end - (codes + 2) + 4;
 
-  uint16_t size = jump < UINT16_MAX ? jump : UINT16_MAX;
-  (*(uint8_t*)parser.function->block->opcodes->data[codes]) =
-      (size >> 8) & 0xFF;
-  (*(uint8_t*)parser.function->block->opcodes->data[codes + 1]) = size & 0xFF;
+  uint16_t size = jump_size(jump);
+  block_patch_u16(parser.function->block, codes, size);
 
   // jump back to before the conditional to run again
-  block_new_opcodes_3(parser.function->block, OP_JUMP_BACK, 0xFF, 0xFF);
-  codes = parser.function->block->opcodes->size - 2;
-  size = (codes + 1 - start) < UINT16_MAX ? (codes + 1 - start) : UINT16_MAX;
-  (*(uint8_t*)parser.function->block->opcodes->data[codes]) =
-      (size >> 8) & 0xFF;
-  (*(uint8_t*)parser.function->block->opcodes->data[codes + 1]) = size & 0xFF;
+  block_new_opcodes_3(
+      parser.function->block, OP_JUMP_BACK, 0xFF, 0xFF, parser.previous.line);
+  codes = parser.function->block->size - 2;
+  size = jump_size(codes + 1 - start);
+  block_patch_u16(parser.function->block, codes, size);
 }
 
 /**
@@ -722,81 +878,76 @@ static void statement_for() {
     if (parser.previous.type != TOKEN_SEMICOLON)
       consume(TOKEN_SEMICOLON);
   } else {
-    expression(PREC_ASSIGNMENT);
+    expression_statement();
     consume(TOKEN_SEMICOLON);
   }
 
   // conditional
-  int start = parser.function->block->opcodes->size;
+  int start = parser.function->block->size;
   int conditionalJump = -1;
   Value condition = value_new_boolean(true);
   if (match(TOKEN_SEMICOLON)) {
     // no conditional
   } else {
     expression(PREC_ASSIGNMENT);
-    if (condition.type != VAL_BOOL) {
+    if (!value_is_boolean(condition)) {
       parse_error("Expected value type VAL_BOOL but got ");
       value_print_type(&condition);
       printf("\n");
       return;
     }
     consume(TOKEN_SEMICOLON);
-    block_new_opcodes_3(parser.function->block, OP_CJUMPF, 0xFF, 0xFF);
-    conditionalJump = parser.function->block->opcodes->size - 2;
+    block_new_opcodes_3(
+        parser.function->block, OP_CJUMPF, 0xFF, 0xFF, parser.previous.line);
+    conditionalJump = parser.function->block->size - 2;
   }
-  block_new_opcodes_3(parser.function->block, OP_JUMP, 0xFF, 0xFF);
+  block_new_opcodes_3(
+      parser.function->block, OP_JUMP, 0xFF, 0xFF, parser.previous.line);
 
-  int postPos = parser.function->block->opcodes->size - 2;
+  int postPos = parser.function->block->size - 2;
 
   // post expression
   if (match(TOKEN_RPAREN)) {
     // no post expression
   } else {
-    expression(PREC_ASSIGNMENT);
+    expression_statement();
     consume(TOKEN_RPAREN);
   }
 
   // jump back to the conditional after the post condition
   {
-    int jsize =
-        parser.function->block->opcodes->size - start + 2;  // +2 for jump codes
-    uint16_t size = jsize < UINT16_MAX ? jsize : UINT16_MAX;
+    int jsize = parser.function->block->size - start + 2;  // +2 for jump codes
+    uint16_t size = jump_size(jsize);
     block_new_opcodes_3(parser.function->block, OP_JUMP_BACK,
-                        (size >> 8) & 0xFF, size & 0xFF);
+                        (size >> 8) & 0xFF, size & 0xFF, parser.previous.line);
   }
   {
     int postJump;
     if (conditionalJump == -1) {
-      postJump = parser.function->block->opcodes->size - postPos - 1;
+      postJump = parser.function->block->size - postPos - 1;
     } else
-      postJump = parser.function->block->opcodes->size - conditionalJump - 4;
-    uint16_t size = postJump < UINT16_MAX ? postJump : UINT16_MAX;
-    (*(uint8_t*)parser.function->block->opcodes->data[postPos]) =
-        (size >> 8) & 0xFF;
-    (*(uint8_t*)parser.function->block->opcodes->data[postPos + 1]) =
-        size & 0xFF;
+      postJump = parser.function->block->size - conditionalJump - 4;
+    uint16_t size = jump_size(postJump);
+    block_patch_u16(parser.function->block, postPos, size);
   }
 
   statement();
 
-  int end = parser.function->block->opcodes->size;
+  int end = parser.function->block->size;
 
   // jump back to the post condition
   {
     int jsize = end - postPos;
-    uint16_t size = jsize < UINT16_MAX ? jsize : UINT16_MAX;
+    uint16_t size = jump_size(jsize);
     block_new_opcodes_3(parser.function->block, OP_JUMP_BACK,
-                        (size >> 8) & 0xFF, size & 0xFF);
+                        (size >> 8) & 0xFF, size & 0xFF, parser.previous.line);
   }
 
   // patch the conditional jump to jump to the end of the block
   if (conditionalJump != -1) {
-    int jump = parser.function->block->opcodes->size - conditionalJump - 1;
-    uint16_t size = jump < UINT16_MAX ? jump : UINT16_MAX;
-    (*(uint8_t*)parser.function->block->opcodes->data[conditionalJump]) =
-        (size >> 8) & 0xFF;
-    (*(uint8_t*)parser.function->block->opcodes->data[conditionalJump + 1]) =
-        size & 0xFF;
+    int jump = parser.function->block->size - conditionalJump - 1;
+    uint16_t size = jump_size(jump);
+    block_patch_u16(parser.function->block, conditionalJump, size);
   }
 
   pop_locals();
@@ -820,29 +971,33 @@ static void statement_struct_template() {
   consume(TOKEN_IDENTIFIER);
   Token name = parser.previous;
   PString* name_string = p_object_string_new_n(name.start, name.length);
+  gc_pin((PObject*)name_string);
   consume(TOKEN_LBRACE);
   PStructTemplate* template = p_object_struct_template_new(name_string);
+  gc_pin((PObject*)template);
   int index = 0;
   while (!match(TOKEN_RBRACE)) {
     consume(TOKEN_IDENTIFIER);
-    char field[200] = {0};
-    memcpy(field, parser.previous.start, parser.previous.length);
-    hash_table_set(&template->fields, field, &value_new_number(index++));
+    PString* field =
+        p_object_string_new_n(parser.previous.start, parser.previous.length);
+    // fields are laid out in declaration order in every instance
+    if (!hash_table_set(&template->fields, field, value_new_integer(index)))
+      parse_error("Duplicate field '%s' in struct '%s'\n", field->value,
+                  name_string->value);
+    index++;
     consume(TOKEN_COMMA);
   }
-  block_new_opcodes(
-      parser.function->block, OP_CONSTANT,
-      block_new_constant(parser.function->block, &value_new_object(template)));
+  block_new_constant_opcode(parser.function->block,
+                            &value_new_object(template), parser.previous.line);
   if (parser.scope) {
-    block_new_opcodes(parser.function->block, OP_LOCAL_SET, new_local(&name));
+    int local = new_local(&name);
+    if (local != -1)
+      block_new_opcode_operand(parser.function->block, OP_LOCAL_SET,
+                               OP_LOCAL_SET_LONG, local, parser.previous.line);
   } else {
-    hash_table_set(&parser.globals, name_string->value,
-                   &value_new_object(template));
-    block_new_opcodes(parser.function->block, OP_CONSTANT,
-                      block_new_constant(parser.function->block,
-                                         &value_new_object(name_string)));
-    block_new_opcode(parser.function->block, OP_GLOBAL_SET);
+    global_set(new_global(name_string));
   }
+  gc_unpin(2);
 }
 
 /**
@@ -851,7 +1006,7 @@ static void statement_struct_template() {
 void statement() {
   if (match(TOKEN_PRINT)) {
     expression(PREC_ASSIGNMENT);
-    block_new_opcode(parser.function->block, OP_PRINT);
+    block_new_opcode(parser.function->block, OP_PRINT, parser.previous.line);
   } else if (match(TOKEN_IF)) {
     statement_if();
   } else if (match(TOKEN_LET)) {
@@ -866,14 +1021,14 @@ void statement() {
     statement_for();
   } else if (match(TOKEN_RETURN)) {
     expression(PREC_ASSIGNMENT);
-    block_new_opcode(parser.function->block, OP_RETURN);
+    block_new_opcode(parser.function->block, OP_RETURN, parser.previous.line);
   } else if (match(TOKEN_EXIT)) {
     expression(PREC_ASSIGNMENT);
-    block_new_opcode(parser.function->block, OP_EXIT);
+    block_new_opcode(parser.function->block, OP_EXIT, parser.previous.line);
   } else if (match(TOKEN_LBRACE)) {
     statement_block();
   } else {
-    expression(PREC_ASSIGNMENT);
+    expression_statement();
   }
   match(TOKEN_SEMICOLON);
 
@@ -882,19 +1037,41 @@ void statement() {
   }
 }
 
+/**
+ * @brief Gives each standard library builtin a global slot and emits the code
+ * that stores the builtins in their slots when the script starts.
+ */
+static void define_standard_lib() {
+  init_standard_lib(&parser.builtins);
+  for (int i = 0; i < parser.builtins.capacity; i++) {
+    Entry* entry = &parser.builtins.entries[i];
+    if (entry->key == NULL)
+      continue;
+    block_new_constant_opcode(parser.function->block, &entry->value, 0);
+    block_new_opcode_operand(parser.function->block, OP_GLOBAL_SET_SLOT,
+                             OP_GLOBAL_SET_SLOT_LONG, new_global(entry->key),
+                             0);
+  }
+}
+
 /**
  * Parses tokens of a script and returns the script as a function.
  *
  * @return char* the name of the function.
  */
 PFunction* parse_script(char* name) {
-  parser.function = p_object_function_new(p_object_string_new(name));
+  PString* script_name = p_object_string_new(name);
+  gc_pin((PObject*)script_name);
+  parser.function = p_object_function_new(script_name);
+  gc_unpin(1);
+  define_standard_lib();
 
   while (!match(TOKEN_EOF)) {
     statement();
   }
 
-  block_new_opcode(parser.function->block, OP_RETURN);
+  block_new_opcode(parser.function->block, OP_RETURN, parser.previous.line);
+  parser.function->max_stack = parser.function->block->max_stack;
 
   if (parser.had_error) {
     return NULL;
@@ -924,6 +1101,7 @@ PFunction* parse_function(PFunction* target) {
   consume(TOKEN_LBRACE);
 
   PFunction* enclosing = parser.function;
+  gc_pin((PObject*)enclosing);
 
   parser.function = target;
 
@@ -935,10 +1113,12 @@ PFunction* parse_function(PFunction* target) {
     parse_error("Expected '}' at end of function");
   }
 
-  block_new_opcode(parser.function->block, OP_RETURN);
+  block_new_opcode(parser.function->block, OP_RETURN, parser.previous.line);
 
   parser.scope--;
   pop_locals();
+  target->max_stack = target->block->max_stack;
+  gc_unpin(1);
 
   if (parser.had_error) {
     return NULL;
@@ -15,7 +15,7 @@
 #include "positron.h"
 #include "token.h"
 
-#define MAX_LOCALS UINT8_MAX
+#define MAX_LOCALS MAX_LONG_OPERAND
 
 typedef enum Precedence {
   PREC_NONE,
@@ -50,9 +50,17 @@ typedef struct Parser {
   Token previous;
   PFunction* function;
   HashTable globals;
+  // standard library builtins waiting to be given global slots
+  HashTable builtins;
+  size_t global_count;
   size_t scope;
-  Local locals[MAX_LOCALS];
+  Local* locals;
   size_t local_count;
+  size_t local_capacity;
+  // size of the current block right after the last expression that leaves
+  // no value behind, an assignment or a dropped value, see
+  // expression_statement()
+  size_t consumed_end;
   bool had_error;
 } Parser;
 
@@ -64,6 +72,10 @@ void parse_error(const char* format, ...);
 PFunction* parse_script(char* name);
 // parses a function
 PFunction* parse_function(PFunction* function);
+// returns the number of global slots the parsed script uses
+size_t parser_global_count();
+// marks the objects the parser holds for the garbage collector
+void parser_mark_roots();
 // frees the parser's memory
 void parser_free();
 ParseRule* get_rule(enum TokenType type);
@@ -0,0 +1,198 @@
+/**
+ * @file pool.c
+ * @author Devin Arena
+ * @brief Size class pool allocator for heap objects. Objects come in a
+ * handful of fixed sizes, so each size class keeps the blocks freed by the
+ * garbage collector on a free list and reuses them without going through
+ * malloc. Building with POSITRON_NO_POOL sends every allocation to malloc,
+ * which lets sanitizers see each object on its own.
+ * @since 10/16/2026
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+Pool pool;
+
+/**
+ * @brief Returns the index of the size class for an allocation size.
+ */
+static inline size_t size_class(size_t size) {
+  return (size + POOL_GRANULARITY - 1) / POOL_GRANULARITY - 1;
+}
+
+/**
+ * @brief Records an allocation in a class's statistics.
+ */
+static inline void count_allocation(PoolStats* stats) {
+  stats->allocations++;
+  stats->live++;
+  if (stats->live > stats->peak)
+    stats->peak = stats->live;
+}
+
+/**
+ * @brief Gives a size class a fresh chunk to carve blocks from. The chunk's
+ * first block is used to link it into the pool's chunk list.
+ *
+ * @param class the size class to refill
+ * @param block_size the size of the class's blocks
+ */
+static void pool_new_chunk(PoolClass* class, size_t block_size) {
+  uint8_t* chunk = malloc(POOL_CHUNK_SIZE);
+  if (!chunk) {
+    printf("Failed to allocate memory for a pool chunk.\n");
+    exit(1);
+  }
+  *(void**)chunk = pool.chunks;
+  pool.chunks = chunk;
+  class->next = chunk + block_size;
+  class->end = chunk + POOL_CHUNK_SIZE - POOL_CHUNK_SIZE % block_size;
+  class->stats.chunks++;
+}
+
+/**
+ * @brief Allocates a block of at least size bytes. Small blocks are taken
+ * from their size class's free list, or carved from its current chunk when
+ * the free list is empty.
+ *
+ * @param size the number of bytes needed
+ * @return void* the block
+ */
+void* pool_alloc(size_t size) {
+#ifndef POSITRON_NO_POOL
+  if (size <= POOL_MAX_SIZE) {
+    PoolClass* class = &pool.classes[size_class(size)];
+    count_allocation(&class->stats);
+    void* block = class->free_list;
+    if (block != NULL) {
+      class->free_list = *(void**)block;
+      return block;
+    }
+    size_t block_size = (size_class(size) + 1) * POOL_GRANULARITY;
+    if (class->next == class->end)
+      pool_new_chunk(class, block_size);
+    block = class->next;
+    class->next += block_size;
+    return block;
+  }
+#endif
+  count_allocation(&pool.large);
+  void* block = malloc(size);
+  if (!block) {
+    printf("Failed to allocate memory for an object.\n");
+    exit(1);
+  }
+  return block;
+}
+
+/**
+ * @brief Returns a block to the pool it was allocated from.
+ *
+ * @param block the block to release
+ * @param size the size the block was allocated with
+ */
+void pool_release(void* block, size_t size) {
+#ifndef POSITRON_NO_POOL
+  if (size <= POOL_MAX_SIZE) {
+    PoolClass* class = &pool.classes[size_class(size)];
+    class->stats.frees++;
+    class->stats.live--;
+    *(void**)block = class->free_list;
+    class->free_list = block;
+    return;
+  }
+#endif
+  pool.large.frees++;
+  pool.large.live--;
+  free(block);
+}
+
+/**
+ * @brief Adds a released block to a batch instead of the pool itself. The
+ * blocks of each size class are chained through their first word like the
+ * free lists, so the whole chain can be spliced onto its free list later.
+ * Large blocks are freed right away, which malloc allows from any thread.
+ *
+ * @param batch the batch to add to
+ * @param block the block to release
+ * @param size the size the block was allocated with
+ */
+void pool_batch_add(PoolBatch* batch, void* block, size_t size) {
+#ifndef POSITRON_NO_POOL
+  if (size <= POOL_MAX_SIZE) {
+    size_t class = size_class(size);
+    *(void**)block = batch->heads[class];
+    if (batch->heads[class] == NULL)
+      batch->tails[class] = block;
+    batch->heads[class] = block;
+    batch->counts[class]++;
+    return;
+  }
+#endif
+  batch->large_frees++;
+  free(block);
+}
+
+/**
+ * @brief Returns every block in a batch to its size class's free list and
+ * empties the batch. Must not run alongside any other pool function.
+ *
+ * @param batch the batch to release
+ */
+void pool_release_batch(PoolBatch* batch) {
+  for (size_t i = 0; i < POOL_CLASSES; i++) {
+    if (batch->heads[i] == NULL)
+      continue;
+    PoolClass* class = &pool.classes[i];
+    *(void**)batch->tails[i] = class->free_list;
+    class->free_list = batch->heads[i];
+    class->stats.frees += batch->counts[i];
+    class->stats.live -= batch->counts[i];
+  }
+  pool.large.frees += batch->large_frees;
+  pool.large.live -= batch->large_frees;
+  *batch = (PoolBatch){0};
+}
+
+/**
+ * @brief Prints one line of allocation statistics.
+ */
+static void print_class(const char* name, PoolStats* stats) {
+  fprintf(stderr,
+          "pool: %-6s %10llu allocs %10llu frees %8zu live %8zu peak "
+          "%5zu chunks\n",
+          name, (unsigned long long)stats->allocations,
+          (unsigned long long)stats->frees, stats->live, stats->peak,
+          stats->chunks);
+}
+
+/**
+ * @brief Prints the statistics of every size class that was used to stderr.
+ */
+void pool_print_stats() {
+  char name[16];
+  for (size_t i = 0; i < POOL_CLASSES; i++) {
+    if (pool.classes[i].stats.allocations == 0)
+      continue;
+    snprintf(name, sizeof(name), "%zu", (i + 1) * POOL_GRANULARITY);
+    print_class(name, &pool.classes[i].stats);
+  }
+  if (pool.large.allocations > 0)
+    print_class("large", &pool.large);
+}
+
+/**
+ * @brief Frees every chunk and resets the pool. Blocks still allocated from
+ * the chunks are freed with them, large blocks must be released first.
+ */
+void pool_free() {
+  while (pool.chunks != NULL) {
+    void* next = *(void**)pool.chunks;
+    free(pool.chunks);
+    pool.chunks = next;
+  }
+  pool = (Pool){0};
+}
@@ -0,0 +1,72 @@
+/**
+ * @file pool.h
+ * @author Devin Arena
+ * @brief Size class pool allocator for heap objects.
+ * @since 10/16/2026
+ **/
+
+#ifndef POSITRON_POOL_H
+#define POSITRON_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// sizes are rounded up to a multiple of this, which is also the alignment of
+// every block handed out
+#define POOL_GRANULARITY 16
+// larger allocations go straight to malloc
+#define POOL_MAX_SIZE 256
+#define POOL_CLASSES (POOL_MAX_SIZE / POOL_GRANULARITY)
+// size of the chunks the blocks of a class are carved from
+#define POOL_CHUNK_SIZE (64 * 1024)
+
+typedef struct PoolStats {
+  uint64_t allocations;
+  uint64_t frees;
+  size_t live;
+  size_t peak;
+  size_t chunks;
+} PoolStats;
+
+// one size class, freed blocks are kept on a free list threaded through the
+// blocks themselves and new ones are carved from the current chunk
+typedef struct PoolClass {
+  void* free_list;
+  uint8_t* next;
+  uint8_t* end;
+  PoolStats stats;
+} PoolClass;
+
+// blocks released by one thread, returned to the pool in one go by
+// pool_release_batch() so threads can release blocks without locking
+typedef struct PoolBatch {
+  void* heads[POOL_CLASSES];
+  void* tails[POOL_CLASSES];
+  size_t counts[POOL_CLASSES];
+  size_t large_frees;
+} PoolBatch;
+
+typedef struct Pool {
+  PoolClass classes[POOL_CLASSES];
+  // every chunk, linked through its first word so they can be freed
+  void* chunks;
+  // allocations larger than POOL_MAX_SIZE
+  PoolStats large;
+} Pool;
+
+extern Pool pool;
+
+// returns a block of at least size bytes.
+void* pool_alloc(size_t size);
+// returns a block allocated with pool_alloc() with the same size to its pool.
+void pool_release(void* block, size_t size);
+// adds a block allocated with pool_alloc() with the same size to a batch.
+void pool_batch_add(PoolBatch* batch, void* block, size_t size);
+// returns every block in a batch to its pool and empties the batch.
+void pool_release_batch(PoolBatch* batch);
+// prints the allocation statistics of every size class used to stderr.
+void pool_print_stats();
+// frees every chunk, along with any block still allocated from them.
+void pool_free();
+
+#endif
@@ -1,4 +1,13 @@
 
 #include "positron.h"
 
-bool DEBUG_MODE = false;
\ No newline at end of file
+bool DEBUG_MODE = false;
+bool GC_STATS = false;
+bool ALLOC_STATS = false;
+bool GC_INCREMENTAL = false;
+double GC_MAX_PAUSE = DEFAULT_GC_MAX_PAUSE;
+size_t GC_THREADS = DEFAULT_GC_THREADS;
+size_t STACK_SIZE = DEFAULT_STACK_SIZE;
+size_t STACK_MAX = DEFAULT_STACK_MAX;
+size_t FRAMES_SIZE = DEFAULT_FRAMES_SIZE;
+size_t FRAMES_MAX = DEFAULT_FRAMES_MAX;
@@ -10,12 +10,42 @@
 #define POSITRON_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 extern bool DEBUG_MODE;
+// print garbage collection statistics when the program ends
+extern bool GC_STATS;
+// print the allocator's per size class statistics when the program ends
+extern bool ALLOC_STATS;
+// collect garbage in slices interleaved with the program instead of all at
+// once, each slice pausing for at most GC_MAX_PAUSE milliseconds plus the
+// time it takes to promote the nursery's survivors when it finishes marking
+extern bool GC_INCREMENTAL;
+extern double GC_MAX_PAUSE;
+// threads full collections mark and sweep large heaps with, counting the
+// main thread
+extern size_t GC_THREADS;
 
-#define STACK_SIZE UINT8_MAX
-#define MAX_FRAMES UINT8_MAX
+// initial and maximum sizes of the value and call frame stacks, the stacks
+// start small and grow as needed up to the maximum
+extern size_t STACK_SIZE;
+extern size_t STACK_MAX;
+extern size_t FRAMES_SIZE;
+extern size_t FRAMES_MAX;
+
+#define DEFAULT_STACK_SIZE 256
+#define DEFAULT_STACK_MAX (1 << 24)
+#define DEFAULT_FRAMES_SIZE 64
+#define DEFAULT_FRAMES_MAX (1 << 20)
+#define DEFAULT_GC_MAX_PAUSE 1.0
+#define DEFAULT_GC_THREADS 1
 
 #define POSITRON_DEBUG
 
+// dispatch the interpreter loop through a table of label addresses when the
+// compiler supports it, build with -DPOSITRON_NO_COMPUTED_GOTO to use a switch
+#if defined(__GNUC__) && !defined(POSITRON_NO_COMPUTED_GOTO)
+#define POSITRON_COMPUTED_GOTO
+#endif
+
 #endif
\ No newline at end of file
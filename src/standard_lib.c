@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include "gc.h"
 #include "standard_lib.h"
 
 /**
@@ -22,23 +23,28 @@
  * @param args the arguments
  * @return Value
  */
-Value p_wln(PObject* parent, size_t argc, Value* args) {
+Value p_wln(PObject* receiver, size_t argc, Value* args) {
   assert(argc == 1);
   value_print(args);
   printf("\n");
   return value_new_null();
 }
 
-Value p_abs(PObject* parent, size_t argc, Value* args) {
+Value p_abs(PObject* receiver, size_t argc, Value* args) {
   assert(argc == 1);
-  if (args[0].type != VAL_NUMBER) {
+  if (value_is_integer(args[0])) {
+    int64_t integer = value_as_integer(args[0]);
+    if (integer >= -VALUE_INTEGER_MAX)
+      return value_new_integer(integer < 0 ? -integer : integer);
+  }
+  if (!value_is_numeric(args[0])) {
     printf("abs() only takes a number as an argument");
     exit(1);
   }
-  return value_new_number(fabs(args[0].data.number));
+  return value_new_number(fabs(value_to_number(args[0])));
 }
 
-Value p_clock(PObject* parent, size_t argc, Value* _args) {
+Value p_clock(PObject* receiver, size_t argc, Value* _args) {
   assert(argc == 0);
   return value_new_number((double)clock());
 }
@@ -47,28 +53,35 @@ Value p_clock(PObject* parent, size_t argc, Value* _args) {
  * @brief Builtin methods for lists.
  */
 
-Value p_list_size(PObject* parent, size_t argc, Value* args) {
+Value p_list_size(PObject* receiver, size_t argc, Value* args) {
   assert(argc == 0);
-  return value_new_number(((PList*)parent)->list->size);
+  return value_new_integer(((PList*)receiver)->count);
 }
 
-Value p_list_add(PObject* parent, size_t argc, Value* args) {
+Value p_list_add(PObject* receiver, size_t argc, Value* args) {
   assert(argc == 1);
-  dyn_list_add(((PList*)parent)->list, value_clone(args + 0));
+  p_object_list_append((PList*)receiver, args[0]);
   return value_new_null();
 }
 
-#define ADD_STD_LIB(name, argc)               \
-  hash_table_set(                             \
-      table, #name,                           \
-      &value_new_object(p_object_builtin_new( \
-          NULL, p_object_string_new_n(#name, sizeof(#name)), p_##name, argc)))
+/**
+ * @brief Adds a builtin function to a table under its name.
+ */
+static void add_builtin(HashTable* table,
+                        const char* name,
+                        BuiltinFn function,
+                        size_t arity) {
+  PString* key = p_object_string_new(name);
+  gc_pin((PObject*)key);
+  PBuiltin* builtin = p_object_builtin_new(key, function, arity);
+  gc_unpin(1);
+  hash_table_set(table, key, value_new_object((PObject*)builtin));
+}
+
+#define ADD_STD_LIB(name, argc) add_builtin(table, #name, p_##name, argc)
 
-#define ADD_STD_LIB_N(name, function, argc)                             \
-  hash_table_set(table, #name,                                          \
-                 &value_new_object(p_object_builtin_new(                \
-                     NULL, p_object_string_new_n(#name, sizeof(#name)), \
-                     (#function), argc)))
+#define ADD_STD_LIB_N(name, function, argc) \
+  add_builtin(table, #name, function, argc)
 
 /**
  * @brief Initializes the standard library.
@@ -77,4 +90,12 @@ void init_standard_lib(HashTable* table) {
   ADD_STD_LIB(abs, 1);
   ADD_STD_LIB(wln, 1);
   ADD_STD_LIB(clock, 0);
+}
+
+/**
+ * @brief Initializes the methods shared by every list.
+ */
+void init_list_methods(HashTable* table) {
+  ADD_STD_LIB_N(size, p_list_size, 0);
+  ADD_STD_LIB_N(add, p_list_add, 1);
 }
\ No newline at end of file
@@ -13,8 +13,9 @@
 #include "value.h"
 
 void init_standard_lib(HashTable* table);
+void init_list_methods(HashTable* table);
 
-Value p_list_size(PObject* parent, size_t argc, Value* args);
-Value p_list_add(PObject* parent, size_t argc, Value* args);
+Value p_list_size(PObject* receiver, size_t argc, Value* args);
+Value p_list_add(PObject* receiver, size_t argc, Value* args);
 
 #endif
\ No newline at end of file
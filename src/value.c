@@ -17,7 +17,7 @@
  * @brief Returns the truthiness of a value.
  * - null is always false
  * - bools are based on their boolean value
- * - integers and floats are true if != 0
+ * - integers are true if != 0, floats if they are not close to 0
  * - objects (pointers) are true if != NULL
  *
  * @param value
@@ -25,40 +25,22 @@
  * @return false
  */
 bool value_is_truthy(Value* value) {
-  switch (value->type) {
+  switch (value_type(*value)) {
     case VAL_NULL:
       return false;
     case VAL_BOOL:
-      return value->data.boolean;
+      return value_as_boolean(*value);
     case VAL_NUMBER:
-      return fabs(value->data.number) > 0.00001f;
+      return fabs(value_as_number(*value)) > 0.00001f;
+    case VAL_INTEGER:
+      return value_as_integer(*value) != 0;
     case VAL_OBJ:
-      return value->data.reference != NULL;
+      return value_as_object(*value) != NULL;
     default:
       return false;
   }
 }
 
-/**
- * @brief Clones a value as a heap allocated value.
- *
- * @param value the value to clone
- * @return Value* a newly allocated clone of that value
- */
-Value* value_clone(Value* value) {
-  Value* clone = malloc(sizeof(Value));
-
-  if (!clone) {
-    printf("Failed to allocate memory for value clone.\n");
-    exit(1);
-  }
-
-  clone->type = value->type;
-  clone->data = value->data;
-
-  return clone;
-}
-
 /**
  * @brief Gets the value type associated with a token type.
  *
@@ -74,7 +56,7 @@ enum ValueType value_type_from_token_type(enum TokenType type) {
     case TOKEN_BOOL:
       return VAL_BOOL;
     case TOKEN_LITERAL_INTEGER:
-      return VAL_NUMBER;
+      return VAL_INTEGER;
     case TOKEN_LITERAL_FLOATING:
       return VAL_NUMBER;
     case TOKEN_LITERAL_STRING:
@@ -91,22 +73,25 @@ enum ValueType value_type_from_token_type(enum TokenType type) {
  * @param value the value to print
  */
 void value_print(Value* value) {
-  switch (value->type) {
+  switch (value_type(*value)) {
     case VAL_NULL:
       printf("null");
       break;
     case VAL_BOOL:
-      printf("%s", value->data.boolean ? "true" : "false");
+      printf("%s", value_as_boolean(*value) ? "true" : "false");
       break;
     case VAL_NUMBER:
       // print as an integer if it's an integer
-      if (value->data.number == (int)value->data.number)
-        printf("%d", (int)value->data.number);
+      if (value_as_number(*value) == (int)value_as_number(*value))
+        printf("%d", (int)value_as_number(*value));
       else
-        printf("%f", value->data.number);
+        printf("%f", value_as_number(*value));
+      break;
+    case VAL_INTEGER:
+      printf("%lld", (long long)value_as_integer(*value));
       break;
     case VAL_OBJ:
-      p_object_print(value->data.reference);
+      p_object_print(value_as_object(*value));
       break;
     default:
       printf("null");
@@ -120,12 +105,12 @@ void value_print(Value* value) {
  * @param value the value to print
  */
 void value_print_type(Value* value) {
-  switch (value->type) {
+  switch (value_type(*value)) {
     case VAL_OBJ:
-      p_object_type_print(value->data.reference);
+      p_object_type_print(value_as_object(*value));
       break;
     default:
-      value_type_print_type(value->type);
+      value_type_print_type(value_type(*value));
       break;
   }
 }
@@ -146,6 +131,9 @@ void value_type_print_type(enum ValueType type) {
     case VAL_NUMBER:
       printf("f32");
       break;
+    case VAL_INTEGER:
+      printf("i64");
+      break;
     case VAL_OBJ:
       printf("obj");
       break;
@@ -154,10 +142,3 @@ void value_type_print_type(enum ValueType type) {
       break;
   }
 }
-
-/**
- * @brief Frees the memory allocated by a value.
- */
-void value_free(Value* value) {
-  free(value);
-}
\ No newline at end of file
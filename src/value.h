@@ -10,6 +10,8 @@
 #define POSITRON_VALUE_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "token.h"
 
@@ -19,23 +21,120 @@ typedef enum ValueType {
   VAL_NULL,
   VAL_BOOL,
   VAL_NUMBER,
+  VAL_INTEGER,
   VAL_OBJ
 } ValueType;
 
+#ifdef POSITRON_NAN_BOXING
+
+/**
+ * NaN-boxed values fit in 8 bytes. Any double that is not a quiet NaN with
+ * the bits below set is a number. Null and booleans are small tags inside the
+ * quiet NaN space, integers are quiet NaNs with bit 48 set and a 48-bit two's
+ * complement payload, and objects are quiet NaNs with the sign bit set and the
+ * pointer in the low 48 bits.
+ */
+typedef uint64_t Value;
+
+#define VALUE_SIGN_BIT ((uint64_t)0x8000000000000000)
+#define VALUE_QNAN ((uint64_t)0x7ffc000000000000)
+
+#define VALUE_TAG_NULL 1
+#define VALUE_TAG_FALSE 2
+#define VALUE_TAG_TRUE 3
+#define VALUE_TAG_INTEGER ((uint64_t)1 << 48)
+#define VALUE_INTEGER_MASK (((uint64_t)1 << 48) - 1)
+
+// integers outside this range are stored as numbers instead
+#define VALUE_INTEGER_MIN (-((int64_t)1 << 47))
+#define VALUE_INTEGER_MAX (((int64_t)1 << 47) - 1)
+
+#define VALUE_NULL (VALUE_QNAN | VALUE_TAG_NULL)
+#define VALUE_FALSE (VALUE_QNAN | VALUE_TAG_FALSE)
+#define VALUE_TRUE (VALUE_QNAN | VALUE_TAG_TRUE)
+
+static inline double value_to_double(Value value) {
+  double number;
+  memcpy(&number, &value, sizeof(double));
+  return number;
+}
+
+static inline Value value_from_double(double number) {
+  Value value;
+  memcpy(&value, &number, sizeof(double));
+  return value;
+}
+
+#define value_is_number(val) (((val) & VALUE_QNAN) != VALUE_QNAN)
+#define value_is_null(val) ((val) == VALUE_NULL)
+#define value_is_boolean(val) (((val) | 1) == VALUE_TRUE)
+#define value_is_integer(val)                                     \
+  (((val) & (VALUE_SIGN_BIT | VALUE_QNAN | VALUE_TAG_INTEGER)) == \
+   (VALUE_QNAN | VALUE_TAG_INTEGER))
+#define value_is_object(val) \
+  (((val) & (VALUE_QNAN | VALUE_SIGN_BIT)) == (VALUE_QNAN | VALUE_SIGN_BIT))
+
+#define value_as_number(val) value_to_double(val)
+#define value_as_boolean(val) ((val) == VALUE_TRUE)
+// shifts the payload up against the sign bit and back to sign extend it
+#define value_as_integer(val) ((int64_t)((val) << 16) >> 16)
+#define value_as_object(val) \
+  ((PObject*)(uintptr_t)((val) & ~(VALUE_SIGN_BIT | VALUE_QNAN)))
+
+/**
+ * @brief Returns the type of a value.
+ */
+static inline ValueType value_type(Value value) {
+  if (value_is_number(value))
+    return VAL_NUMBER;
+  if (value_is_object(value))
+    return VAL_OBJ;
+  if (value_is_integer(value))
+    return VAL_INTEGER;
+  if (value_is_boolean(value))
+    return VAL_BOOL;
+  return VAL_NULL;
+}
+
+#else
+
 typedef struct {
   enum ValueType type;
   union data {
     double number;
+    int64_t integer;
     bool boolean;
     PObject* reference;
   } data;
 } Value;
 
+#define VALUE_INTEGER_MIN INT64_MIN
+#define VALUE_INTEGER_MAX INT64_MAX
+
+#define value_type(val) ((val).type)
+
+#define value_is_number(val) ((val).type == VAL_NUMBER)
+#define value_is_null(val) ((val).type == VAL_NULL)
+#define value_is_boolean(val) ((val).type == VAL_BOOL)
+#define value_is_integer(val) ((val).type == VAL_INTEGER)
+#define value_is_object(val) ((val).type == VAL_OBJ)
+
+#define value_as_number(val) ((val).data.number)
+#define value_as_boolean(val) ((val).data.boolean)
+#define value_as_integer(val) ((val).data.integer)
+#define value_as_object(val) ((val).data.reference)
+
+#endif
+
+// integers and numbers are both numeric, integers convert to doubles when
+// mixed with numbers
+#define value_is_numeric(val) (value_is_integer(val) || value_is_number(val))
+#define value_to_number(val) \
+  (value_is_integer(val) ? (double)value_as_integer(val) : value_as_number(val))
+
 // returns the truthiness of a value (see function)
 bool value_is_truthy(Value* value);
 
-// clones a value as a heap-allocated value
-Value* value_clone(Value* value);
 // Gets the value type associated with a token type
 ValueType value_type_from_token_type(enum TokenType type);
 
@@ -45,19 +144,63 @@ void value_print(Value* value);
 void value_print_type(Value* value);
 // prints the type of a ValueType
 void value_type_print_type(enum ValueType value);
-// frees the memory allocated by a value
-void value_free(Value* value);
 
 /////////////////////////////
 // Value definition macros
 /////////////////////////////
 
+#ifdef POSITRON_NAN_BOXING
+
+// NaN-boxed constructors are compound literals too, so their address can be
+// taken like the struct versions
+
+/**
+ * @brief Returns a new 32-bit floating point value.
+ */
+#define value_new_number(val) ((Value){value_from_double(val)})
+
+/**
+ * @brief Returns a new integer value, val must be within VALUE_INTEGER_MIN and
+ * VALUE_INTEGER_MAX.
+ */
+#define value_new_integer(val)                  \
+  ((Value){VALUE_QNAN | VALUE_TAG_INTEGER | \
+           ((uint64_t)(val) & VALUE_INTEGER_MASK)})
+
+/**
+ * @brief Returns a new null value.
+ */
+#define value_new_null() ((Value){VALUE_NULL})
+
+/**
+ * @brief Returns a new object value.
+ *
+ * @param val a pointer to the object
+ */
+#define value_new_object(val) \
+  ((Value){VALUE_SIGN_BIT | VALUE_QNAN | (uint64_t)(uintptr_t)(val)})
+
+/**
+ * @brief Returns a new boolean value.
+ *
+ * @param data the data to store in the value
+ */
+#define value_new_boolean(val) ((Value){(val) ? VALUE_TRUE : VALUE_FALSE})
+
+#else
+
 /**
  * @brief Returns a new 32-bit floating point value.
  */
 #define value_new_number(val) \
   ((Value){.type = VAL_NUMBER, .data.number = (val)})
 
+/**
+ * @brief Returns a new 64-bit integer value.
+ */
+#define value_new_integer(val) \
+  ((Value){.type = VAL_INTEGER, .data.integer = (val)})
+
 /**
  * @brief Returns a new null value.
  */
@@ -79,4 +222,6 @@ void value_free(Value* value);
 #define value_new_boolean(val) \
   ((Value){.type = VAL_BOOL, .data.boolean = (val)})
 
+#endif
+
 #endif
\ No newline at end of file